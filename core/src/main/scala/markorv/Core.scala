@@ -206,6 +206,7 @@ class MarkoRvCore(implicit val c: CoreConfig) extends Module {
     rob.io.trap <> exceptionUnit.io.trap
     rob.io.exceptionRet <> exceptionUnit.io.exceptionRet
     misc.io.setPrivilege <> exceptionUnit.io.setPrivilege
+    misc.io.interruptPending := (io.meip && csrFile.io.mie(11)) || (io.mtip && csrFile.io.mie(7)) || (io.msip && csrFile.io.mie(3))
 
     // AMO
     lsu.io.invalidateReserved := rob.io.exceptionRet
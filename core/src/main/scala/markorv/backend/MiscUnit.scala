@@ -2,6 +2,7 @@ package markorv.backend
 
 import chisel3._
 import chisel3.util._
+import chisel3.util.circt.dpi._
 
 import markorv.utils.ChiselUtils._
 import markorv.exception._
@@ -30,6 +31,11 @@ object MemoryOperation extends ChiselEnum {
     val fenceI = Value("h2".U)
 }
 
+class WfiDebug extends DPIClockedVoidFunctionImport {
+    val functionName = "update_wfi"
+    override val inputNames = Some(Seq("waiting"))
+}
+
 class MISCUnit(implicit val c: CoreConfig) extends Module {
     val io = IO(new Bundle {
         val miscInstr = Flipped(Decoupled(new Bundle {
@@ -41,6 +47,9 @@ class MISCUnit(implicit val c: CoreConfig) extends Module {
         val csrio = Flipped(new ControlStatusRegistersIO)
         val outfire = Output(Bool())
 
+        // Any interrupt pending and enabled in mie, wakes up wfi
+        val interruptPending = Input(Bool())
+
         val getPrivilege = Output(UInt(2.W))
         val setPrivilege = Flipped(Decoupled(UInt(2.W)))
 
@@ -60,6 +69,7 @@ class MISCUnit(implicit val c: CoreConfig) extends Module {
     val (memOp, validMemOp) = MemoryOperation.safe(opcode.miscMemFunct)
 
     val validOp = io.miscInstr.valid && (validCsrOp || validSysOp || validMemOp)
+    val wfiWaiting = WireInit(false.B)
 
     io.csrio.readEn := false.B
     io.csrio.writeEn := false.B
@@ -106,7 +116,10 @@ class MISCUnit(implicit val c: CoreConfig) extends Module {
         when(validSysOp) {
             switch(sysOp) {
                 is(SystemOperation.wfi) {
-                    io.outfire := true.B // wfi treated as NOP
+                    // Hold wfi until an interrupt is pending, then commit it so the ROB drains and the interrupt is taken
+                    io.commit.valid := io.interruptPending
+                    io.outfire := io.interruptPending && io.commit.ready
+                    wfiWaiting := ~io.interruptPending
                 }
                 is(SystemOperation.ecall) {
                     io.commit.valid := true.B
@@ -159,4 +172,9 @@ class MISCUnit(implicit val c: CoreConfig) extends Module {
     when(io.setPrivilege.valid) {
         privilegeReg := io.setPrivilege.bits
     }
-}
+
+    if(c.simulate) {
+        val wfiDebugger = new WfiDebug
+        wfiDebugger.call(wfiWaiting)
+    }
+}
\ No newline at end of file
@@ -2,9 +2,17 @@ package markorv
 
 import chisel3._
 import chisel3.util._
+import chisel3.util.circt.dpi._
+
 import markorv.exception._
+import markorv.config._
+
+class TrapDebug extends DPIClockedVoidFunctionImport {
+    val functionName = "update_trap"
+    override val inputNames = Some(Seq("valid", "interrupt", "cause", "epc", "vector"))
+}
 
-class ExceptionUnit extends Module {
+class ExceptionUnit(implicit val c: CoreConfig) extends Module {
     val io = IO(new Bundle {
         // Interrupt signals
         // ========================
@@ -106,4 +114,11 @@ class ExceptionUnit extends Module {
         io.setPrivilege.valid := true.B
         io.setPrivilege.bits := io.setException.privilege
     }
+
+    // Debug
+    if(c.simulate) {
+        val trapDebugger = new TrapDebug
+        trapDebugger.call(io.setException.set, exceptionInfo.interruption, exceptionInfo.causeCode.pad(32),
+            exceptionInfo.state.exceptionPc, io.setException.exceptionHandler)
+    }
 }
\ No newline at end of file
@@ -14,6 +14,11 @@ class ReorderBufferDebug extends DPIClockedVoidFunctionImport {
     override val inputNames = Some(Seq("entry", "index"))
 }
 
+class RetireDebug extends DPIClockedVoidFunctionImport {
+    val functionName = "update_retire"
+    override val inputNames = Some(Seq("valid", "index", "pc", "exu", "trap", "cause", "recover", "xret"))
+}
+
 class ReorderBuffer(implicit val c: CoreConfig) extends Module {
     private val robIndexWidth = log2Ceil(c.robSize)
     private val renameIndexWidth = log2Ceil(c.renameTableSize)
@@ -185,5 +190,11 @@ class ReorderBuffer(implicit val c: CoreConfig) extends Module {
         for((e,i) <- buffer.zipWithIndex) {
             debugger.call(e, i.U(32.W))
         }
+
+        // The registered buffer misses an entry committed and retired in the same cycle, report retirement directly
+        val retireDebugger = new RetireDebug
+        val head = nextBuffer(deqPtr)
+        retireDebugger.call(retireValid, deqPtr.pad(32), head.pc, head.exu.asUInt.pad(32),
+            trapRequired, head.fCtrl.cause.pad(32), recoverRequired, exceptionRetRequired)
     }
 }
\ No newline at end of file
@@ -1,5 +1,202 @@
 #include "arg_parser.hpp"
 
+// Hex start:end, end optional
+static bool parse_hex_range(const std::string &option, const std::string &range,
+                            std::optional<uint64_t> &start, std::optional<uint64_t> &end) {
+    auto sep = range.find(':');
+    try {
+        if (sep == std::string::npos)
+            throw std::invalid_argument("missing end");
+        start = std::stoull(range.substr(0, sep), nullptr, 16);
+        if (sep + 1 < range.size())
+            end = std::stoull(range.substr(sep + 1), nullptr, 16);
+    } catch (...) {
+        std::cerr << "Invalid --" << option << " value: " << range << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Guest RAM must lie in one cacheable RAM region of the core's PMA table, the core faults on accesses elsewhere
+static bool ram_in_pma(uint64_t base, uint64_t size) {
+    struct pmaRegion {
+        uint64_t addr_low;
+        uint64_t addr_high;
+        bool r, w, x, c, a;
+    };
+#define PMA_REGION(...) pmaRegion{__VA_ARGS__},
+    static constexpr pmaRegion regions[] = { CFG_PMA_REGIONS(PMA_REGION) };
+#undef PMA_REGION
+    if (size == 0 || base + size - 1 < base)
+        return false;
+    return std::ranges::any_of(regions, [&](const pmaRegion& region) {
+        return region.r && region.w && region.x && region.c &&
+               base >= region.addr_low && base + size - 1 <= region.addr_high;
+    });
+}
+
+// Options that may differ between the children of a --fork-at run
+static void add_variant_options(cxxopts::Options &options) {
+    options.add_options()
+        ("ram-dump", "Dump the memory after the run is complete", cxxopts::value<std::string>())
+        ("ram-dump-range", "Only dump this RAM range (hex addr:len, repeatable)", cxxopts::value<std::vector<std::string>>())
+        ("ram-dump-sparse", "Dump only pages holding data, as {addr, len, bytes} records")
+        ("stats", "Write a JSON report of simulation speed and host time per phase, slave and DPI hook", cxxopts::value<std::string>())
+        ("guest-profile", "Sample the fetch PC and write a flat profile here and folded stacks to <file>.folded", cxxopts::value<std::string>())
+        ("guest-profile-interval", "Cycles between two guest profile samples", cxxopts::value<uint64_t>())
+        ("instr-mix", "Write a JSON report of issued and retired instructions per EXU, op and class", cxxopts::value<std::string>())
+        ("occupancy", "Write ROB/RS/RF occupancy, IPC and EXU busy time series (CSV if the name ends in .csv, JSON otherwise)", cxxopts::value<std::string>())
+        ("occupancy-interval", "Cycles per row of the occupancy time series", cxxopts::value<uint64_t>())
+        ("result-addr", "Report the 64-bit words at these addrs(comma separated) after the run", cxxopts::value<std::vector<uint64_t>>())
+        ("overlay", "Copy a raw file into guest memory before running (hex addr:path, repeatable)", cxxopts::value<std::vector<std::string>>())
+        ("uart-input", "Feed the bytes of a file to the UART receiver instead of stdin", cxxopts::value<std::string>())
+        ("uart-out", "Send UART output to a file, a new pty (pty) or a unix socket (unix:path)", cxxopts::value<std::string>())
+        ("irq-inject", "Set a PLIC source level at a cycle (hex cycle:source:level, repeatable)", cxxopts::value<std::vector<std::string>>());
+}
+
+static int read_variant_options(const cxxopts::ParseResult &result, parsedArgs &args) {
+    if (result.count("ram-dump")) {
+        args.ram_dump = result["ram-dump"].as<std::string>();
+    }
+
+    if (result.count("ram-dump-range")) {
+        args.ram_dump_ranges.clear();
+        for (const auto& range : result["ram-dump-range"].as<std::vector<std::string>>()) {
+            auto sep = range.find(':');
+            try {
+                if (sep == std::string::npos)
+                    throw std::invalid_argument("missing length");
+                args.ram_dump_ranges.push_back({std::stoull(range.substr(0, sep), nullptr, 16), std::stoull(range.substr(sep + 1), nullptr, 16)});
+            } catch (...) {
+                std::cerr << "Invalid --ram-dump-range value: " << range << "\n";
+                return 1;
+            }
+        }
+    }
+
+    if (result.count("ram-dump-sparse")) {
+        args.ram_dump_sparse = true;
+    }
+
+    if (result.count("stats")) {
+        args.stats = result["stats"].as<std::string>();
+    }
+
+    if (result.count("guest-profile")) {
+        args.guest_profile = result["guest-profile"].as<std::string>();
+    }
+
+    if (result.count("guest-profile-interval")) {
+        args.guest_profile_interval = result["guest-profile-interval"].as<uint64_t>();
+        if (args.guest_profile_interval == 0) {
+            std::cerr << "--guest-profile-interval must be at least 1\n";
+            return 1;
+        }
+    }
+
+    if (result.count("instr-mix")) {
+        args.instr_mix = result["instr-mix"].as<std::string>();
+    }
+
+    if (result.count("occupancy")) {
+        args.occupancy = result["occupancy"].as<std::string>();
+    }
+
+    if (result.count("occupancy-interval")) {
+        args.occupancy_interval = result["occupancy-interval"].as<uint64_t>();
+        if (args.occupancy_interval == 0) {
+            std::cerr << "--occupancy-interval must be at least 1\n";
+            return 1;
+        }
+    }
+
+    if (result.count("result-addr")) {
+        args.result_addrs = result["result-addr"].as<std::vector<uint64_t>>();
+    }
+
+    if (result.count("overlay")) {
+        args.overlays.clear();
+        for (const auto& overlay : result["overlay"].as<std::vector<std::string>>()) {
+            auto sep = overlay.find(':');
+            try {
+                if (sep == std::string::npos)
+                    throw std::invalid_argument("missing path");
+                args.overlays.push_back({std::stoull(overlay.substr(0, sep), nullptr, 16), overlay.substr(sep + 1)});
+            } catch (...) {
+                std::cerr << "Invalid --overlay value: " << overlay << "\n";
+                return 1;
+            }
+        }
+    }
+
+    if (result.count("uart-input")) {
+        args.uart_input = result["uart-input"].as<std::string>();
+    }
+
+    if (result.count("uart-out")) {
+        args.uart_out = result["uart-out"].as<std::string>();
+    }
+
+    if (result.count("irq-inject")) {
+        args.irq_injections.clear();
+        for (const auto& inject : result["irq-inject"].as<std::vector<std::string>>()) {
+            auto first = inject.find(':');
+            auto second = inject.find(':', first == std::string::npos ? first : first + 1);
+            try {
+                if (second == std::string::npos)
+                    throw std::invalid_argument("missing field");
+                args.irq_injections.push_back({
+                    std::stoull(inject.substr(0, first), nullptr, 16),
+                    static_cast<uint16_t>(std::stoul(inject.substr(first + 1, second - first - 1))),
+                    std::stoul(inject.substr(second + 1)) != 0
+                });
+            } catch (...) {
+                std::cerr << "Invalid --irq-inject value: " << inject << "\n";
+                return 1;
+            }
+        }
+        std::ranges::stable_sort(args.irq_injections, {}, &irqInjection::cycle);
+    }
+
+    return 0;
+}
+
+int parse_variant(const std::string &line, const parsedArgs &base, parsedArgs &args) {
+    try {
+        cxxopts::Options options("variant", "Fork variant options");
+        add_variant_options(options);
+
+        std::vector<std::string> tokens = {"variant"};
+        std::istringstream stream(line);
+        for (std::string token; stream >> token;) {
+            tokens.push_back(token);
+        }
+        std::vector<char*> argv;
+        for (auto& token : tokens) {
+            argv.push_back(token.data());
+        }
+
+        auto result = options.parse(argv.size(), argv.data());
+        args = base;
+        args.ram_dump.reset();
+        args.ram_dump_ranges.clear();
+        args.ram_dump_sparse = false;
+        args.stats.reset();
+        args.guest_profile.reset();
+        args.instr_mix.reset();
+        args.occupancy.reset();
+        args.result_addrs.clear();
+        args.overlays.clear();
+        args.uart_input.reset();
+        args.uart_out.reset();
+        args.irq_injections.clear();
+        return read_variant_options(result, args);
+    } catch (...) {
+        std::cerr << "Error parsing variant options: " << line << "\n";
+        return 1;
+    }
+}
+
 int parse_args(int argc, char **argv, parsedArgs &args) {
     try {
         cxxopts::Options options(argv[0], "MarkoRvCore simulator");
@@ -7,13 +204,44 @@ int parse_args(int argc, char **argv, parsedArgs &args) {
         options.add_options()
             ("rom-path", "Path to ROM payload", cxxopts::value<std::string>())
             ("ram-path", "Path to RAM payload", cxxopts::value<std::string>())
-            ("ram-dump", "Dump the memory after the run is complete", cxxopts::value<std::string>())
             ("vcd-dump", "Dump the waveform after the run is complete", cxxopts::value<std::string>())
+            ("fst-dump", "Dump the waveform as FST (simulator built with TRACE_FST=1)", cxxopts::value<std::string>())
+            ("trace-window", "Only dump the waveform of these cycles (hex start:end, end exclusive and optional)", cxxopts::value<std::string>())
+            ("trace-trigger", "Start the waveform once the fetch PC reaches one of these symbols or hex addrs (comma separated)", cxxopts::value<std::vector<std::string>>())
+            ("trace-mmio", "Start the waveform on a guest write to this address (hex value)", cxxopts::value<std::string>())
+            ("trace-length", "Cycles of waveform after a trigger (hex value, default: until the run ends)", cxxopts::value<std::string>())
+            ("trace-scope", "Only dump these instances of the core, e.g. rob,dCache (comma separated)", cxxopts::value<std::vector<std::string>>())
             ("max-clock", "Maximum clock cycles to simulate (hex value)", cxxopts::value<std::string>()->default_value(std::to_string(CFG_DEFAULT_MAX_CLOCK)))
+            ("ram-base", "Guest RAM base address (hex value, must lie in the cacheable RAM PMA region of core_config.yaml)", cxxopts::value<std::string>())
+            ("ram-size", "Guest RAM size in bytes (hex value, 4k multiple, base+size must stay in that PMA region, pages are committed on first touch)", cxxopts::value<std::string>())
+            ("ram-thp", "Back guest RAM with transparent huge pages")
+            ("ram-file", "Back guest RAM with a shared mapping of this file, it holds the memory image after the run", cxxopts::value<std::string>())
+            ("save-checkpoint", "Save a checkpoint at this clock cycle (hex value)", cxxopts::value<std::string>())
+            ("restore-checkpoint", "Resume the simulation from a checkpoint file", cxxopts::value<std::string>())
+            ("checkpoint-file", "File written by --save-checkpoint", cxxopts::value<std::string>()->default_value("sim.ckpt"))
             ("verbose", "Enable verbose output")
-            ("d,debug", "Enable debug options (comma separated: axi,rob,rs,rt,rf)", cxxopts::value<std::vector<std::string>>())
+            ("capstone", "Disassemble --verbose output with Capstone (simulator built with CAPSTONE=1)")
+            ("axi-outstanding", "Maximum number of AXI reads and writes in flight at once", cxxopts::value<uint64_t>()->default_value(std::to_string(CFG_AXI_MAX_OUTSTANDING)))
+            ("axi-out-of-order", "Complete AXI transactions of different IDs out of order")
+            ("mem-timing", "Apply the memoryTiming model of core_config.yaml to memory accesses")
+            ("idle-skip", "Fast-forward mtime to the next timer/interrupt event while the core waits in wfi")
+            ("stop-at", "Stop once the fetch PC reaches one of these symbols or hex addrs (comma separated)", cxxopts::value<std::vector<std::string>>())
+            ("exec-trace", "Write a binary trace of every cycle and DPI structure change, decoded by markorv-trace", cxxopts::value<std::string>())
+            ("exec-trace-mmap", "Write --exec-trace through a shared mapping of the file instead of a buffer")
+            ("flight-depth", "Cycles held by the flight recorder, 0 disables it", cxxopts::value<uint64_t>()->default_value(std::to_string(CFG_FLIGHT_RECORDER_DEPTH)))
+            ("flight-file", "Record the last cycles and dump them to this file on timeout, AXI DECERR, an unexpected trap vector or SIGINT/SIGTERM", cxxopts::value<std::string>())
+            ("trap-vector", "Expected trap handler symbols or hex addrs (comma separated, default: anywhere in ROM or RAM)", cxxopts::value<std::vector<std::string>>())
+            ("d,debug", "Enable debug options (comma separated: axi,rob,rs,rt,rf, full prints whole tables instead of changes)", cxxopts::value<std::vector<std::string>>())
+            ("debug-window", "Only print --debug output in these cycles (hex start:end, end exclusive and optional)", cxxopts::value<std::string>())
+            ("debug-pc", "Only print --debug output while the fetch PC is in this range (hex start:end, end exclusive and optional)", cxxopts::value<std::string>())
             ("cleanup-dcache", "Clean certain addrs(comma separated) of dcache data at end of simulation", cxxopts::value<std::vector<uint64_t>>())
+            ("fork-at", "Simulate the common prefix up to this cycle (hex value), then fork one child per variant", cxxopts::value<std::string>())
+            ("fork-variants", "File with the options of one fork variant per line", cxxopts::value<std::string>())
+            ("fork-jobs", "Maximum number of fork variants running at once (default: all cores)", cxxopts::value<uint64_t>())
+            ("server", "Read one job (simulator options) per line from stdin and print one JSON result per line")
+            ("server-threads", "Number of simulation instances serving jobs in parallel", cxxopts::value<uint64_t>()->default_value("1"))
             ("help", "Print usage information");
+        add_variant_options(options);
 
         auto result = options.parse(argc, argv);
 
@@ -22,21 +250,80 @@ int parse_args(int argc, char **argv, parsedArgs &args) {
             return 1;
         }
 
+        // The RAM layout belongs to the simulator instance, so it is read in server mode too
+        for (const auto& [option, value] : {std::pair{"ram-base", &args.ram_base}, std::pair{"ram-size", &args.ram_size}}) {
+            if (!result.count(option))
+                continue;
+            try {
+                *value = std::stoull(result[option].as<std::string>(), nullptr, 16);
+            } catch (...) {
+                std::cerr << "Invalid hex value for --" << option << "\n";
+                return 1;
+            }
+        }
+        if (!ram_in_pma(args.ram_base, args.ram_size)) {
+            std::cerr << std::format("Error: RAM 0x{:x}+0x{:x} is outside the cacheable RAM PMA region of the core.\n",
+                                     args.ram_base, args.ram_size);
+            return 1;
+        }
+        if (result.count("ram-thp"))
+            args.ram_huge_pages = true;
+        if (result.count("ram-file"))
+            args.ram_file = result["ram-file"].as<std::string>();
+
+        args.server = result.count("server") > 0;
+        if (args.server) {
+            if (result.count("server-threads"))
+                args.server_threads = result["server-threads"].as<uint64_t>();
+            if (args.ram_file && args.server_threads > 1) {
+                std::cerr << "Error: --ram-file can't be shared by several server threads.\n";
+                return 1;
+            }
+            return 0;
+        }
+
         if (!result.count("ram-path") || !result.count("rom-path")) {
             std::cerr << "Error: --ram-path and --rom-path are required.\n";
-            std::cout << options.help() << std::endl;
+            std::cerr << options.help() << std::endl;
             return 1;
         }
 
         args.ram_path = result["ram-path"].as<std::string>();
         args.rom_path = result["rom-path"].as<std::string>();
 
-        if (result.count("ram-dump")) {
-            args.ram_dump = result["ram-dump"].as<std::string>();
+        if (result.count("vcd-dump") && result.count("fst-dump")) {
+            std::cerr << "Error: --vcd-dump and --fst-dump can't be used together.\n";
+            return 1;
         }
-
         if (result.count("vcd-dump")) {
-            args.vcd_dump = result["vcd-dump"].as<std::string>();
+            args.wave_dump = result["vcd-dump"].as<std::string>();
+        }
+        if (result.count("fst-dump")) {
+            args.wave_dump = result["fst-dump"].as<std::string>();
+            args.wave_fst = true;
+        }
+
+        if (result.count("trace-window") &&
+            !parse_hex_range("trace-window", result["trace-window"].as<std::string>(), args.trace_start, args.trace_end))
+            return 1;
+
+        for (const auto& [option, value] : {std::pair{"trace-mmio", &args.trace_mmio}, std::pair{"trace-length", &args.trace_length}}) {
+            if (!result.count(option))
+                continue;
+            try {
+                *value = std::stoull(result[option].as<std::string>(), nullptr, 16);
+            } catch (...) {
+                std::cerr << "Invalid hex value for --" << option << "\n";
+                return 1;
+            }
+        }
+
+        if (result.count("trace-trigger")) {
+            args.trace_triggers = result["trace-trigger"].as<std::vector<std::string>>();
+        }
+
+        if (result.count("trace-scope")) {
+            args.trace_scopes = result["trace-scope"].as<std::vector<std::string>>();
         }
 
         if (result.count("max-clock")) {
@@ -50,7 +337,29 @@ int parse_args(int argc, char **argv, parsedArgs &args) {
             args.max_clock = CFG_DEFAULT_MAX_CLOCK;
         }
 
+        if (result.count("save-checkpoint")) {
+            try {
+                args.save_checkpoint = std::stoull(result["save-checkpoint"].as<std::string>(), nullptr, 16);
+            } catch (...) {
+                std::cerr << "Invalid hex value for --save-checkpoint\n";
+                return 1;
+            }
+        }
+
+        if (result.count("restore-checkpoint")) {
+            args.restore_checkpoint = result["restore-checkpoint"].as<std::string>();
+        }
+
+        if (result.count("checkpoint-file")) {
+            args.checkpoint_file = result["checkpoint-file"].as<std::string>();
+        }
+
         args.verbose = result.count("verbose") > 0;
+        args.capstone = result.count("capstone") > 0;
+        args.idle_skip = result.count("idle-skip") > 0;
+        args.axi_outstanding = result["axi-outstanding"].as<uint64_t>();
+        args.axi_out_of_order = result.count("axi-out-of-order") > 0;
+        args.mem_timing = result.count("mem-timing") > 0;
         if (result.count("debug")) {
             auto debug_flags = result["debug"].as<std::vector<std::string>>();
             for (const auto& flag : debug_flags) {
@@ -59,18 +368,65 @@ int parse_args(int argc, char **argv, parsedArgs &args) {
                 else if (flag == "rs") args.rs_debug = true;
                 else if (flag == "rt") args.rt_debug = true;
                 else if (flag == "rf") args.rf_debug = true;
+                else if (flag == "full") args.debug_full = true;
                 else {
                     std::cerr << "Warning: Unknown debug flag: " << flag << std::endl;
                 }
             }
         }
 
+        if (result.count("debug-window") &&
+            !parse_hex_range("debug-window", result["debug-window"].as<std::string>(), args.debug_start, args.debug_end))
+            return 1;
+        if (result.count("debug-pc") &&
+            !parse_hex_range("debug-pc", result["debug-pc"].as<std::string>(), args.debug_pc_start, args.debug_pc_end))
+            return 1;
+
+        if (result.count("stop-at")) {
+            args.stop_at = result["stop-at"].as<std::vector<std::string>>();
+        }
+
+        if (result.count("exec-trace")) {
+            args.exec_trace = result["exec-trace"].as<std::string>();
+        }
+        args.exec_trace_mmap = result.count("exec-trace-mmap") > 0;
+        args.flight_depth = result["flight-depth"].as<uint64_t>();
+        if (result.count("flight-file")) {
+            args.flight_file = result["flight-file"].as<std::string>();
+        }
+        if (result.count("trap-vector")) {
+            args.trap_vectors = result["trap-vector"].as<std::vector<std::string>>();
+        }
+
         if(result.count("cleanup-dcache")) {
             args.cleanup_dcache_addrs = result["cleanup-dcache"].as<std::vector<uint64_t>>();
         }
 
-        std::cout << std::format("ROM payload path: {}\n", args.rom_path);
-        std::cout << std::format("RAM payload path: {}\n", args.ram_path);
+        if (read_variant_options(result, args) != 0)
+            return 1;
+
+        if (result.count("fork-at") != result.count("fork-variants")) {
+            std::cerr << "Error: --fork-at and --fork-variants must be used together.\n";
+            return 1;
+        }
+
+        if (result.count("fork-at")) {
+            try {
+                args.fork_at = std::stoull(result["fork-at"].as<std::string>(), nullptr, 16);
+            } catch (...) {
+                std::cerr << "Invalid hex value for --fork-at\n";
+                return 1;
+            }
+            args.fork_variants = result["fork-variants"].as<std::string>();
+            if (args.ram_file) {
+                std::cerr << "Error: fork variants can't share a --ram-file mapping.\n";
+                return 1;
+            }
+        }
+
+        if (result.count("fork-jobs")) {
+            args.fork_jobs = result["fork-jobs"].as<uint64_t>();
+        }
 
         return 0;
     } catch (...) {
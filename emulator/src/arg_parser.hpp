@@ -3,25 +3,93 @@
 #include <optional>
 #include <iostream>
 #include <format>
+#include <sstream>
+#include <algorithm>
 
 #include <cxxopts.hpp>
 
 #include "config.hpp"
 
+struct memOverlay {
+    uint64_t addr;
+    std::string path;
+};
+
+struct memRange {
+    uint64_t addr;
+    uint64_t len;
+};
+
+struct irqInjection {
+    uint64_t cycle;
+    uint16_t source;
+    bool level;
+};
+
 struct parsedArgs {
     std::string ram_path;
     std::string rom_path;
     std::optional<std::string> ram_dump;
-    std::optional<std::string> vcd_dump;
+    std::vector<memRange> ram_dump_ranges;
+    bool ram_dump_sparse = false;
+    std::optional<std::string> ram_file;
+    std::optional<std::string> stats;
+    std::optional<std::string> guest_profile;
+    uint64_t guest_profile_interval = 1;
+    std::optional<std::string> instr_mix;
+    std::optional<std::string> occupancy;
+    uint64_t occupancy_interval = 1000;
+    std::optional<std::string> wave_dump;
+    bool wave_fst = false;
+    std::vector<std::string> trace_scopes;
+    std::optional<uint64_t> trace_start;
+    std::optional<uint64_t> trace_end;
+    std::vector<std::string> trace_triggers;
+    std::optional<uint64_t> trace_mmio;
+    std::optional<uint64_t> trace_length;
+    std::optional<uint64_t> save_checkpoint;
+    std::optional<std::string> restore_checkpoint;
+    std::string checkpoint_file = "sim.ckpt";
     uint64_t max_clock = CFG_DEFAULT_MAX_CLOCK;
+    uint64_t ram_base = CFG_RAM_BASE;
+    uint64_t ram_size = CFG_RAM_SIZE;
+    bool ram_huge_pages = CFG_RAM_HUGE_PAGES;
     bool verbose = false;
+    bool capstone = false;
     bool axi_debug = false;
     bool rob_debug = false;
     bool rs_debug = false;
     bool rt_debug = false;
     bool rf_debug = false;
+    bool debug_full = false;                // Whole ROB/RS/RT/RF tables every cycle instead of the changes
+    std::optional<uint64_t> debug_start;    // Cycle range of the --debug dumps
+    std::optional<uint64_t> debug_end;      // Exclusive
+    std::optional<uint64_t> debug_pc_start; // Fetch PC range of the --debug dumps
+    std::optional<uint64_t> debug_pc_end;   // Exclusive
+    bool idle_skip = false;
+    uint64_t axi_outstanding = CFG_AXI_MAX_OUTSTANDING;
+    bool axi_out_of_order = false;
+    bool mem_timing = false;
     std::vector<uint64_t> cleanup_dcache_addrs;
+    std::vector<uint64_t> result_addrs;
+    std::vector<std::string> stop_at;
+    uint64_t flight_depth = CFG_FLIGHT_RECORDER_DEPTH;
+    std::optional<std::string> flight_file; // Flight recorder on only when set
+    std::vector<std::string> trap_vectors;
+    std::optional<std::string> exec_trace;
+    bool exec_trace_mmap = false;
+    std::vector<memOverlay> overlays;
+    std::optional<std::string> uart_input;
+    std::optional<std::string> uart_out;
+    std::vector<irqInjection> irq_injections;
+    std::optional<uint64_t> fork_at;
+    std::optional<std::string> fork_variants;
+    uint64_t fork_jobs = 0;
+    bool server = false;
+    uint64_t server_threads = 1;
 };
 
 // Returns 0 on success, 1 on error
 int parse_args(int argc, char **argv, parsedArgs &args);
+// Variant line of --fork-variants on top of the base args, returns 0 on success, 1 on error
+int parse_variant(const std::string &line, const parsedArgs &base, parsedArgs &args);
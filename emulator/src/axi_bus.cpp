@@ -1,5 +1,8 @@
 #include "axi_bus.hpp"
 
+#include <bit>
+#include <cstring>
+
 bool VirtualAxiSlaves::ReservedItem::isConflict(uint64_t addr, uint8_t size) {
     if (!valid) return false;
 
@@ -18,15 +21,28 @@ bool VirtualAxiSlaves::ReservedItem::isConflict(uint64_t addr, uint8_t size) {
 }
 
 VirtualAxiSlaves::VirtualAxiSlaves() {
-    empty_read_transaction();
-    empty_write_transaction();
+    clear_transactions();
     reserved_items.resize(CFG_MAX_RESERVED);
 }
 
 VirtualAxiSlaves::~VirtualAxiSlaves() = default;
 
 uint64_t VirtualAxiSlaves::register_slave(std::shared_ptr<Slave> slave) {
+    if (slave->range.empty())
+        throw std::runtime_error("Slave with an empty address range");
+    Region region = {slave->base_addr + slave->range.front(), slave->base_addr + slave->range.back() + 1, slaves.size()};
+
+    auto next = std::ranges::upper_bound(regions, region.start, {}, &Region::start);
+    bool overlap = (next != regions.end() && next->start < region.end) ||
+                   (next != regions.begin() && std::prev(next)->end > region.start);
+    if (overlap)
+        throw std::runtime_error(std::format("Slave region 0x{:x}-0x{:x} overlaps a registered slave", region.start, region.end));
+    regions.insert(next, region);
+    last_region = 0;
+
     slaves.emplace_back(std::move(slave));
+    step_counters.push_back(0);
+    access_counters.push_back(0);
     return slaves.size() - 1;
 }
 
@@ -34,37 +50,265 @@ std::shared_ptr<Slave> VirtualAxiSlaves::get_slave(uint64_t id) {
     return slaves[id];
 }
 
+std::optional<uint64_t> VirtualAxiSlaves::peek(uint64_t addr, uint8_t size) {
+    // Direct slave access bypassing the bus, only meant for side-effect free slaves
+    size_t slave_index;
+    Slave* slave = decode(addr, slave_index);
+    if (!slave)
+        return std::nullopt;
+    return slave->read(addr - slave->base_addr, size);
+}
+
+Slave* VirtualAxiSlaves::decode(uint64_t addr, size_t& slave_index) {
+    // Bursts and polling loops keep hitting the same device
+    if (last_region < regions.size()) {
+        const auto& hit = regions[last_region];
+        if (addr >= hit.start && addr < hit.end) {
+            slave_index = hit.slave;
+            return slaves[hit.slave].get();
+        }
+    }
+
+    auto next = std::ranges::upper_bound(regions, addr, {}, &Region::start);
+    if (next == regions.begin())
+        return nullptr;
+    auto region = std::prev(next);
+    if (addr >= region->end)
+        return nullptr;
+    last_region = region - regions.begin();
+    slave_index = region->slave;
+    return slaves[region->slave].get();
+}
+
+void VirtualAxiSlaves::reset() {
+    clear_transactions();
+    bus_cycle = 0;
+    for (auto& model : timing_models) {
+        model.reset();
+    }
+    std::ranges::fill(reserved_items, ReservedItem{});
+    reserved_replace_ptr = 0;
+    write_watches.clear();
+    for (const auto& slave : slaves) {
+        slave->reset();
+    }
+}
+
+void VirtualAxiSlaves::configure(size_t outstanding, bool out_of_order) {
+    max_outstanding = std::max<size_t>(outstanding, 1);
+    this->out_of_order = out_of_order;
+}
+
+void VirtualAxiSlaves::set_timing(const std::vector<memTimingConfig>& regions) {
+    timing_models.clear();
+    for (const auto& region : regions) {
+        timing_models.emplace_back(region);
+    }
+}
+
+uint64_t VirtualAxiSlaves::access_ready(uint64_t addr, uint64_t bytes) {
+    for (auto& model : timing_models) {
+        if (model.contains(addr))
+            return model.schedule(bus_cycle, addr, bytes);
+    }
+    return bus_cycle;
+}
+
+bool VirtualAxiSlaves::is_idle() const {
+    return outstanding_reads == 0 && outstanding_writes == 0;
+}
+
+std::optional<uint64_t> VirtualAxiSlaves::idle_cycles() {
+    std::optional<uint64_t> cycles;
+    for (const auto& slave : slaves) {
+        auto slave_cycles = slave->idle_cycles();
+        if (slave_cycles && (!cycles || *slave_cycles < *cycles))
+            cycles = slave_cycles;
+    }
+    return cycles;
+}
+
+void VirtualAxiSlaves::skip_cycles(uint64_t cycles) {
+    bus_cycle += cycles;
+    for (const auto& slave : slaves) {
+        slave->skip_cycles(cycles);
+    }
+}
+
+void VirtualAxiSlaves::set_profiler(HostProfiler* profiler) {
+    this->profiler = profiler;
+    if (!profiler)
+        return;
+    for (size_t i = 0; i < slaves.size(); i++) {
+        const auto label = std::format("{}@0x{:x}", slaves[i]->name(), slaves[i]->base_addr);
+        step_counters[i] = profiler->add_counter("slaves", label + ".step");
+        access_counters[i] = profiler->add_counter("slaves", label + ".access");
+    }
+}
+
+void VirtualAxiSlaves::save_state(VerilatedSerialize& os) {
+    // Queues are flattened, the per-ID order is kept by the sequence numbers
+    std::vector<ReadTransaction> reads;
+    for (const auto& [id, queue] : read_queues) {
+        reads.insert(reads.end(), queue.begin(), queue.end());
+    }
+    std::vector<WriteTransaction> write_data(write_data_queue.begin(), write_data_queue.end());
+    std::vector<WriteTransaction> write_resps;
+    for (const auto& [id, queue] : write_resp_queues) {
+        write_resps.insert(write_resps.end(), queue.begin(), queue.end());
+    }
+    save_vector(os, reads);
+    save_vector(os, write_data);
+    save_vector(os, write_resps);
+    save_pod(os, active_read);
+    save_pod(os, active_write_resp);
+    save_pod(os, last_read_id);
+    save_pod(os, last_write_id);
+    save_pod(os, next_seq);
+    save_pod(os, bus_cycle);
+    save_pod(os, static_cast<uint64_t>(timing_models.size()));
+    for (auto& model : timing_models) {
+        model.save_state(os);
+    }
+    save_vector(os, reserved_items);
+    save_pod(os, reserved_replace_ptr);
+    save_pod(os, static_cast<uint64_t>(slaves.size()));
+    for (const auto& slave : slaves) {
+        slave->save_state(os);
+    }
+}
+
+void VirtualAxiSlaves::restore_state(VerilatedDeserialize& is) {
+    uint64_t slave_num = 0;
+    std::vector<ReadTransaction> reads;
+    std::vector<WriteTransaction> write_data;
+    std::vector<WriteTransaction> write_resps;
+    restore_vector(is, reads);
+    restore_vector(is, write_data);
+    restore_vector(is, write_resps);
+    restore_pod(is, active_read);
+    restore_pod(is, active_write_resp);
+    restore_pod(is, last_read_id);
+    restore_pod(is, last_write_id);
+    restore_pod(is, next_seq);
+    restore_pod(is, bus_cycle);
+    uint64_t model_num = 0;
+    restore_pod(is, model_num);
+    if (model_num != timing_models.size())
+        throw std::runtime_error("Checkpoint memory timing regions do not match");
+    for (auto& model : timing_models) {
+        model.restore_state(is);
+    }
+
+    read_queues.clear();
+    write_resp_queues.clear();
+    clear_lines(); // Rebuilt from memory on the next beat
+    std::ranges::sort(reads, {}, &ReadTransaction::seq);
+    std::ranges::sort(write_resps, {}, &WriteTransaction::seq);
+    for (const auto& read : reads) {
+        read_queues[read.id].push_back(read);
+    }
+    write_data_queue.assign(write_data.begin(), write_data.end());
+    for (const auto& write : write_resps) {
+        write_resp_queues[write.id].push_back(write);
+    }
+    outstanding_reads = reads.size();
+    outstanding_writes = write_data.size() + write_resps.size();
+    restore_vector(is, reserved_items);
+    restore_pod(is, reserved_replace_ptr);
+    restore_pod(is, slave_num);
+    if (slave_num != slaves.size())
+        throw std::runtime_error("Checkpoint slave set does not match");
+    for (const auto& slave : slaves) {
+        slave->restore_state(is);
+    }
+}
+
+void VirtualAxiSlaves::add_write_watch(uint64_t addr, std::function<void(uint64_t data)> callback) {
+    write_watches.push_back({addr, std::move(callback)});
+}
+
 void VirtualAxiSlaves::sim_step(const std::unique_ptr<VMarkoRvCore> &top, axiSignal &axi) {
+    bus_cycle++;
     handle_top(top);
     handle_read(axi);
     handle_write(axi);
 }
 
-void VirtualAxiSlaves::empty_read_transaction() {
-    current_read.state = STAT_RIDLE;
-    current_read.beat = 0;
-    current_read.held_data = std::nullopt;
-    current_read.addr = 0;
-    current_read.size = 0;
-    current_read.burst = BURST_RESERVED;
-    current_read.id = 0;
-    current_read.len = 0;
-    current_read.lock = false;
+void VirtualAxiSlaves::clear_transactions() {
+    clear_lines();
+    read_queues.clear();
+    write_data_queue.clear();
+    write_resp_queues.clear();
+    active_read.reset();
+    active_write_resp.reset();
+    last_read_id = 0;
+    last_write_id = 0;
+    outstanding_reads = 0;
+    outstanding_writes = 0;
+    next_seq = 0;
+}
+
+template <typename T>
+std::optional<uint16_t> VirtualAxiSlaves::select_id(const std::map<uint16_t, std::deque<T>>& queues, uint16_t last_id) const {
+    if (queues.empty())
+        return std::nullopt;
+
+    auto ready = [this](const auto& entry) { return entry.second.front().ready_cycle <= bus_cycle; };
+    if (out_of_order) {
+        // Rotate between the ready IDs so one busy ID can't starve the others
+        for (auto it = queues.upper_bound(last_id); it != queues.end(); ++it) {
+            if (ready(*it))
+                return it->first;
+        }
+        for (auto it = queues.begin(); it != queues.end() && it->first <= last_id; ++it) {
+            if (ready(*it))
+                return it->first;
+        }
+        return std::nullopt;
+    }
+
+    // In order: the oldest head across all IDs, once its data is ready
+    auto oldest = std::ranges::min_element(queues, {}, [](const auto& entry) { return entry.second.front().seq; });
+    if (!ready(*oldest))
+        return std::nullopt;
+    return oldest->first;
+}
+
+void VirtualAxiSlaves::clear_lines() {
+    read_line_checked = false;
+    read_line_valid = false;
+    write_line = nullptr;
+    write_line_checked = false;
 }
 
-void VirtualAxiSlaves::empty_write_transaction() {
-    current_write.state = STAT_WIDLE;
-    current_write.beat = 0;
-    current_write.addr = 0;
-    current_write.size = 0;
-    current_write.burst = BURST_RESERVED;
-    current_write.id = 0;
-    current_write.len = 0;
-    current_write.lock = false;
-    current_write.resp = RESP_OKAY;
+uint8_t* VirtualAxiSlaves::burst_span(uint64_t addr, uint8_t size, axi_burst_t burst, uint8_t len, uint64_t& start, uint64_t& bytes, size_t& slave_index) {
+    // Full width beats only, their bytes then map 1:1 onto little-endian words
+    if constexpr (std::endian::native != std::endian::little)
+        return nullptr;
+    if (size != 3 || (addr & 0x7) || (burst != BURST_INCR && burst != BURST_WRAP))
+        return nullptr;
+
+    bytes = static_cast<uint64_t>(len + 1) << size;
+    if (burst == BURST_WRAP) {
+        if (!std::has_single_bit(static_cast<uint64_t>(len + 1)))
+            return nullptr;
+        start = addr & ~(bytes - 1);
+    } else {
+        start = addr;
+    }
+
+    // Whole burst inside one 4k page and one slave
+    if ((start & ~0xfffULL) != ((start + bytes - 1) & ~0xfffULL))
+        return nullptr;
+    size_t last_index;
+    Slave* slave = decode(start, slave_index);
+    if (!slave || decode(start + bytes - 1, last_index) != slave)
+        return nullptr;
+    return slave->direct_span(start - slave->base_addr, bytes);
 }
 
-uint64_t VirtualAxiSlaves::calculate_next_addr(uint64_t base_addr, uint8_t size, axi_burst_t burst, uint8_t beat) {
+uint64_t VirtualAxiSlaves::calculate_next_addr(uint64_t base_addr, uint8_t size, axi_burst_t burst, uint8_t len, uint8_t beat) {
     const uint64_t bytes_per_beat = 1 << size;
     switch (burst) {
         case BURST_FIXED:
@@ -75,10 +319,10 @@ uint64_t VirtualAxiSlaves::calculate_next_addr(uint64_t base_addr, uint8_t size,
             return base_addr + beat * bytes_per_beat;
         case BURST_WRAP: {
             // Wrap burst: address wraps within a fixed-size region
-            const uint64_t num_beats = current_read.len + 1;
+            const uint64_t num_beats = len + 1;
             const uint64_t wrap_boundary = num_beats * bytes_per_beat;
             const uint64_t aligned_base = base_addr & ~(wrap_boundary - 1);
-            const uint64_t offset = beat * bytes_per_beat;
+            const uint64_t offset = (base_addr - aligned_base) + beat * bytes_per_beat;
             return aligned_base + (offset % wrap_boundary);
         }
         default:
@@ -88,170 +332,260 @@ uint64_t VirtualAxiSlaves::calculate_next_addr(uint64_t base_addr, uint8_t size,
 }
 
 void VirtualAxiSlaves::handle_top(const std::unique_ptr<VMarkoRvCore> &top) {
-    for(const auto& slave : slaves) {
-        slave->step(top);
+    for (size_t i = 0; i < slaves.size(); i++) {
+        HostProfiler::Scope scope(profiler, step_counters[i]);
+        slaves[i]->step(top);
     }
 }
 
 void VirtualAxiSlaves::handle_read(axiSignal &axi) {
-    switch (current_read.state) {
-        case STAT_RIDLE:
-            axi.arready = true;
-            if (axi.arvalid) {
-                current_read.addr = axi.araddr;
-                current_read.size = axi.arsize;
-                current_read.burst = static_cast<axi_burst_t>(axi.arburst);
-                current_read.id = axi.arid;
-                current_read.len = axi.arlen;
-                current_read.lock = axi.arlock;
-                current_read.state = STAT_SEND;
-                current_read.beat = 0;
+    // Data channel first, a request accepted this cycle is answered from the next one
+    if (!active_read)
+        active_read = select_id(read_queues, last_read_id);
+
+    if (active_read) {
+        auto queue = read_queues.find(*active_read);
+        ReadTransaction& current_read = queue->second.front();
+        axi.rvalid = true;
+        axi.rid = current_read.id;
+        uint64_t current_addr = calculate_next_addr(
+            current_read.addr,
+            current_read.size,
+            current_read.burst,
+            current_read.len,
+            current_read.beat
+        );
+
+        // Line fast path: a whole burst to plain memory is fetched with one copy
+        if (!read_line_checked && !current_read.lock) {
+            read_line_checked = true;
+            uint64_t bytes;
+            size_t slave_index;
+            uint8_t* span = burst_span(current_read.addr, current_read.size, current_read.burst, current_read.len,
+                                       read_line_start, bytes, slave_index);
+            if (span) {
+                HostProfiler::Scope scope(profiler, access_counters[slave_index]);
+                read_line.resize(bytes / sizeof(uint64_t));
+                std::memcpy(read_line.data(), span, bytes);
+                read_line_valid = true;
             }
-            break;
-
-        case STAT_SEND:
-            axi.rvalid = true;
-            axi.rid = current_read.id;
-            uint64_t current_addr = calculate_next_addr(
-                current_read.addr,
-                current_read.size,
-                current_read.burst,
-                current_read.beat
-            );
-
-            auto slave = std::ranges::find_if(slaves,
-                [current_addr](const std::shared_ptr<Slave> &s) -> bool {
-                    return std::ranges::contains(s->range, current_addr - s->base_addr);
-                });
-
-            // Found and not cross 4k boundary.
-            bool addr_valid = (slave != slaves.end()) &&
-                ((current_addr & 0xfffff000) == (current_read.addr & 0xfffff000));
-
-            if (addr_valid) {
-                if (current_read.held_data) {
-                    // Prevent multiple read side effects
-                    axi.rdata = *current_read.held_data;
-                    axi.rresp = current_read.lock ? RESP_EXOKAY : RESP_OKAY;
-                } else {
-                    uint64_t data = (*slave)->read(current_addr - (*slave)->base_addr, current_read.size);
-                    current_read.held_data = data;
-                    axi.rdata = data;
-                    axi.rresp = current_read.lock ? RESP_EXOKAY : RESP_OKAY;
-                }
-                axi.rlast = (current_read.beat == current_read.len);
+        }
+
+        size_t slave_index = 0;
+        Slave* slave = read_line_valid ? nullptr : decode(current_addr, slave_index);
+
+        // Found and not cross 4k boundary.
+        bool addr_valid = slave &&
+            ((current_addr & 0xfffff000) == (current_read.addr & 0xfffff000));
+
+        if (read_line_valid) {
+            axi.rdata = read_line[(current_addr - read_line_start) / sizeof(uint64_t)];
+            axi.rresp = RESP_OKAY;
+            axi.rlast = (current_read.beat == current_read.len);
+        } else if (addr_valid) {
+            if (current_read.held_data) {
+                // Prevent multiple read side effects
+                axi.rdata = *current_read.held_data;
+                axi.rresp = current_read.lock ? RESP_EXOKAY : RESP_OKAY;
             } else {
-                // Invalid address, signal decode error
-                axi.rdata = 0;
-                axi.rlast = true;
-                axi.rresp = RESP_DECERR;
+                HostProfiler::Scope scope(profiler, access_counters[slave_index]);
+                uint64_t data = slave->read(current_addr - slave->base_addr, current_read.size);
+                current_read.held_data = data;
+                axi.rdata = data;
+                axi.rresp = current_read.lock ? RESP_EXOKAY : RESP_OKAY;
             }
+            axi.rlast = (current_read.beat == current_read.len);
+        } else {
+            // Invalid address, signal decode error
+            axi.rdata = 0;
+            axi.rlast = true;
+            axi.rresp = RESP_DECERR;
+        }
 
-            if (axi.rready) {
-                current_read.held_data = std::nullopt;
-
-                if (current_read.lock) {
-                    // Try to reserve the read address
-                    bool reserved = false;
-                    for (auto &item : reserved_items) {
-                        if (!item.valid) {
-                            item.valid = true;
-                            item.addr = current_read.addr;
-                            item.size = current_read.size;
-                            reserved = true;
-                            break;
-                        }
-                    }
-                    if (!reserved) {
-                        static size_t replace_ptr = 0;
-                        reserved_items[replace_ptr] = {true, current_read.addr, current_read.size};
-                        replace_ptr = (replace_ptr + 1) % CFG_MAX_RESERVED;
+        if (axi.rready) {
+            current_read.held_data = std::nullopt;
+
+            if (current_read.lock) {
+                // Try to reserve the read address
+                bool reserved = false;
+                for (auto &item : reserved_items) {
+                    if (!item.valid) {
+                        item.valid = true;
+                        item.addr = current_read.addr;
+                        item.size = current_read.size;
+                        reserved = true;
+                        break;
                     }
                 }
-
-                if (axi.rresp == RESP_DECERR || current_read.beat == current_read.len) {
-                    empty_read_transaction();
-                    break;
+                if (!reserved) {
+                    reserved_items[reserved_replace_ptr] = {true, current_read.addr, current_read.size};
+                    reserved_replace_ptr = (reserved_replace_ptr + 1) % CFG_MAX_RESERVED;
                 }
+            }
 
+            if (axi.rresp == RESP_DECERR || current_read.beat == current_read.len) {
+                last_read_id = current_read.id;
+                queue->second.pop_front();
+                if (queue->second.empty())
+                    read_queues.erase(queue);
+                active_read.reset();
+                read_line_checked = false;
+                read_line_valid = false;
+                outstanding_reads--;
+            } else {
                 current_read.beat++;
             }
-            break;
+        }
+    }
+
+    // Address channel
+    axi.arready = outstanding_reads < max_outstanding;
+    if (axi.arvalid && axi.arready) {
+        read_queues[axi.arid].push_back({
+            .seq = next_seq++,
+            .ready_cycle = access_ready(axi.araddr, static_cast<uint64_t>(axi.arlen + 1) << axi.arsize),
+            .beat = 0,
+            .held_data = std::nullopt,
+            .addr = axi.araddr,
+            .size = axi.arsize,
+            .burst = static_cast<axi_burst_t>(axi.arburst),
+            .id = axi.arid,
+            .len = axi.arlen,
+            .lock = axi.arlock != 0,
+        });
+        outstanding_reads++;
     }
 }
 
 void VirtualAxiSlaves::handle_write(axiSignal &axi) {
-    switch (current_write.state) {
-        case STAT_WIDLE:
-            axi.awready = true;
-            if (axi.awvalid) {
-                current_write.addr = axi.awaddr;
-                current_write.size = axi.awsize;
-                current_write.burst = static_cast<axi_burst_t>(axi.awburst);
-                current_write.id = axi.awid;
-                current_write.len = axi.awlen;
-                current_write.lock = axi.awlock;
-                current_write.beat = 0;
-                current_write.state = STAT_WRITE_DATA;
-            }
-            break;
-
-        case STAT_WRITE_DATA:
-            axi.wready = true;
-            if (axi.wvalid) {
-                uint64_t current_addr = calculate_next_addr(
-                    current_write.addr,
-                    current_write.size,
-                    current_write.burst,
-                    current_write.beat
-                );
-
-                auto slave = std::ranges::find_if(slaves,
-                    [current_addr](const auto& s) {
-                        return std::ranges::contains(s->range, current_addr - s->base_addr);
-                    });
-
-                // Found and not cross 4k boundary.
-                bool addr_valid = (slave != slaves.end()) &&
-                    ((current_addr & 0xfffff000) == (current_write.addr & 0xfffff000));
-
-                if (addr_valid) {
-                    bool reserved_hit = false;
-                    for (auto &item : reserved_items) {
-                        if (item.valid && item.addr == current_addr) {
-                            reserved_hit = true;
-                        }
-                        if (item.valid && item.isConflict(current_addr, current_write.size)) {
-                            item.valid = false;
-                        }
-                    }
+    // Response channel
+    if (!active_write_resp)
+        active_write_resp = select_id(write_resp_queues, last_write_id);
+
+    if (active_write_resp) {
+        auto queue = write_resp_queues.find(*active_write_resp);
+        const WriteTransaction& current_write = queue->second.front();
+        axi.bvalid = true;
+        axi.bresp = current_write.resp;
+        axi.bid = current_write.id;
+        if (axi.bready) {
+            last_write_id = current_write.id;
+            queue->second.pop_front();
+            if (queue->second.empty())
+                write_resp_queues.erase(queue);
+            active_write_resp.reset();
+            outstanding_writes--;
+        }
+    }
 
-                    if (!current_write.lock || (current_write.lock && reserved_hit)) {
-                        (*slave)->write(current_addr - (*slave)->base_addr, axi.wdata, current_write.size, axi.wstrb);
-                    }
+    // Data channel, beats belong to the oldest address without wlast yet
+    axi.wready = !write_data_queue.empty();
+    if (axi.wvalid && axi.wready) {
+        WriteTransaction& current_write = write_data_queue.front();
+        uint64_t current_addr = calculate_next_addr(
+            current_write.addr,
+            current_write.size,
+            current_write.burst,
+            current_write.len,
+            current_write.beat
+        );
+
+        // Line fast path: beats of a burst to plain memory are stored straight into it
+        if (!write_line_checked && !current_write.lock) {
+            write_line_checked = true;
+            uint64_t bytes;
+            write_line = burst_span(current_write.addr, current_write.size, current_write.burst, current_write.len,
+                                    write_line_start, bytes, write_line_slave);
+        }
 
-                    current_write.resp = current_write.lock && reserved_hit ? RESP_EXOKAY : RESP_OKAY;
-                } else {
-                    // Invalid address
-                    current_write.resp = RESP_DECERR;
-                    current_write.state = STAT_WRITE_RESP;
-                }
+        size_t slave_index = write_line_slave;
+        Slave* slave = write_line ? nullptr : decode(current_addr, slave_index);
 
-                if (axi.wlast) {
-                    current_write.state = STAT_WRITE_RESP;
-                }
+        // Found and not cross 4k boundary.
+        bool addr_valid = write_line || (slave &&
+            ((current_addr & 0xfffff000) == (current_write.addr & 0xfffff000)));
 
-                current_write.beat++;
+        if (current_write.resp == RESP_DECERR) {
+            // Drain the rest of a failed burst
+        } else if (addr_valid) {
+            bool reserved_hit = false;
+            for (auto &item : reserved_items) {
+                if (item.valid && item.addr == current_addr) {
+                    reserved_hit = true;
+                }
+                if (item.valid && item.isConflict(current_addr, current_write.size)) {
+                    item.valid = false;
+                }
             }
-            break;
-
-        case STAT_WRITE_RESP:
-            axi.bvalid = true;
-            axi.bresp = current_write.resp;
-            axi.bid = current_write.id;
-            if (axi.bready) {
-                empty_write_transaction();
+
+            if (!current_write.lock || (current_write.lock && reserved_hit)) {
+                HostProfiler::Scope scope(profiler, access_counters[slave_index]);
+                if (!write_line) {
+                    slave->write(current_addr - slave->base_addr, axi.wdata, current_write.size, axi.wstrb);
+                } else if (axi.wstrb == 0xff) {
+                    std::memcpy(write_line + (current_addr - write_line_start), &axi.wdata, sizeof(uint64_t));
+                } else {
+                    uint8_t* target = write_line + (current_addr - write_line_start);
+                    for (int i = 0; i < 8; i++) {
+                        if (axi.wstrb & (1 << i))
+                            target[i] = static_cast<uint8_t>(axi.wdata >> (8 * i));
+                    }
+                }
+                check_write_watches(current_addr, axi.wdata, current_write.size, axi.wstrb);
             }
-            break;
+
+            current_write.resp = current_write.lock && reserved_hit ? RESP_EXOKAY : RESP_OKAY;
+        } else {
+            // Invalid address
+            current_write.resp = RESP_DECERR;
+        }
+
+        current_write.beat++;
+        if (axi.wlast) {
+            current_write.seq = next_seq++;
+            current_write.ready_cycle = access_ready(current_write.addr, static_cast<uint64_t>(current_write.len + 1) << current_write.size);
+            write_resp_queues[current_write.id].push_back(current_write);
+            write_data_queue.pop_front();
+            write_line = nullptr;
+            write_line_checked = false;
+        }
+    }
+
+    // Address channel
+    axi.awready = outstanding_writes < max_outstanding;
+    if (axi.awvalid && axi.awready) {
+        write_data_queue.push_back({
+            .seq = next_seq++,
+            .ready_cycle = 0,
+            .beat = 0,
+            .addr = axi.awaddr,
+            .size = axi.awsize,
+            .burst = static_cast<axi_burst_t>(axi.awburst),
+            .id = axi.awid,
+            .len = axi.awlen,
+            .lock = axi.awlock != 0,
+            .resp = RESP_OKAY,
+        });
+        outstanding_writes++;
+    }
+}
+
+
+void VirtualAxiSlaves::check_write_watches(uint64_t addr, uint64_t data, uint8_t size, uint8_t strb) {
+    const uint64_t bytes_per_beat = 1 << size;
+    for (const auto &watch : write_watches) {
+        if (watch.addr < addr || watch.addr >= addr + bytes_per_beat)
+            continue;
+
+        // Align the beat to the watched address and drop unstrobed bytes
+        const uint64_t offset = watch.addr - addr;
+        if (!(strb & (1 << offset)))
+            continue;
+        uint64_t value = 0;
+        for (uint64_t i = offset; i < bytes_per_beat; i++) {
+            if (strb & (1 << i))
+                value |= ((data >> (8 * i)) & 0xff) << (8 * (i - offset));
+        }
+        watch.callback(value);
     }
 }
@@ -1,7 +1,11 @@
 #pragma once
 #include <memory>
 #include <vector>
+#include <deque>
+#include <map>
 #include <optional>
+#include <functional>
+#include <format>
 #include <cstdint>
 #include <ctime>
 #include <iostream>
@@ -9,17 +13,18 @@
 #include "VMarkoRvCore.h"
 #include "config.hpp"
 #include "axi_signal.hpp"
+#include "profiler.hpp"
+#include "mem_timing.hpp"
 #include "slaves/slave.hpp"
 
 class VirtualAxiSlaves {
 public:
     enum axi_resp_t { RESP_OKAY, RESP_EXOKAY, RESP_SLVERR, RESP_DECERR };
     enum axi_burst_t { BURST_FIXED, BURST_INCR, BURST_WRAP, BURST_RESERVED };
-    enum axi_read_state_t { STAT_RIDLE, STAT_SEND };
-    enum axi_write_state_t { STAT_WIDLE, STAT_WRITE_DATA, STAT_WRITE_RESP };
 
     struct ReadTransaction {
-        axi_read_state_t state;
+        uint64_t seq; // Acceptance order, used for in-order completion
+        uint64_t ready_cycle; // First cycle the data may be returned
         uint8_t beat;
         std::optional<uint64_t> held_data;
         uint64_t addr;
@@ -31,7 +36,8 @@ public:
     };
 
     struct WriteTransaction {
-        axi_write_state_t state;
+        uint64_t seq;
+        uint64_t ready_cycle; // First cycle the response may be sent
         uint8_t beat;
         uint64_t addr;
         uint8_t size;
@@ -49,23 +55,84 @@ public:
         bool isConflict(uint64_t addr, uint8_t size);
     };
 
+    // Bus address range [start, end) decoded to a slave
+    struct Region {
+        uint64_t start;
+        uint64_t end;
+        size_t slave;
+    };
+
+    struct WriteWatch {
+        uint64_t addr;
+        std::function<void(uint64_t data)> callback;
+    };
+
     VirtualAxiSlaves();
     ~VirtualAxiSlaves();
 
     uint64_t register_slave(std::shared_ptr<Slave> slave);
     std::shared_ptr<Slave> get_slave(uint64_t id);
+    void add_write_watch(uint64_t addr, std::function<void(uint64_t data)> callback);
+    std::optional<uint64_t> peek(uint64_t addr, uint8_t size);
+    void reset();
+    // At most `outstanding` reads and writes in flight, out-of-order completion rotates between IDs
+    void configure(size_t outstanding, bool out_of_order);
+    // Memory timing models, accesses outside every region complete at once
+    void set_timing(const std::vector<memTimingConfig>& regions);
+    const std::vector<MemTimingModel>& get_timing() const { return timing_models; }
+    bool is_idle() const;
+    std::optional<uint64_t> idle_cycles();
+    void skip_cycles(uint64_t cycles);
+    void set_profiler(HostProfiler* profiler);
+    void save_state(VerilatedSerialize& os);
+    void restore_state(VerilatedDeserialize& is);
     void sim_step(const std::unique_ptr<VMarkoRvCore> &top, axiSignal &axi);
 
 private:
     std::vector<std::shared_ptr<Slave>> slaves;
-    ReadTransaction current_read;
-    WriteTransaction current_write;
+    std::vector<Region> regions; // Sorted by start, non-overlapping
+    size_t last_region = 0;
+    // Accepted transactions, queued per ID since one ID must complete in order
+    std::map<uint16_t, std::deque<ReadTransaction>> read_queues;
+    std::deque<WriteTransaction> write_data_queue; // W beats follow AW order
+    std::map<uint16_t, std::deque<WriteTransaction>> write_resp_queues;
+    std::optional<uint16_t> active_read; // Burst being returned, not interleaved with others
+    std::optional<uint16_t> active_write_resp;
+    uint16_t last_read_id = 0;
+    uint16_t last_write_id = 0;
+    size_t outstanding_reads = 0;
+    size_t outstanding_writes = 0;
+    uint64_t next_seq = 0;
+    size_t max_outstanding = CFG_AXI_MAX_OUTSTANDING;
+    std::vector<MemTimingModel> timing_models;
+    // Line fast path of the burst at the head of the read and write data channels
+    std::vector<uint64_t> read_line;
+    uint64_t read_line_start = 0;
+    bool read_line_checked = false;
+    bool read_line_valid = false;
+    uint8_t* write_line = nullptr;
+    uint64_t write_line_start = 0;
+    size_t write_line_slave = 0;
+    bool write_line_checked = false;
+    uint64_t bus_cycle = 0;
+    bool out_of_order = false;
     std::vector<ReservedItem> reserved_items;
+    size_t reserved_replace_ptr = 0;
+    std::vector<WriteWatch> write_watches;
+    HostProfiler* profiler = nullptr;
+    std::vector<size_t> step_counters;
+    std::vector<size_t> access_counters;
 
-    void empty_read_transaction();
-    void empty_write_transaction();
-    uint64_t calculate_next_addr(uint64_t base_addr, uint8_t size, axi_burst_t burst, uint8_t beat);
+    Slave* decode(uint64_t addr, size_t& slave_index);
+    void clear_transactions();
+    uint64_t access_ready(uint64_t addr, uint64_t bytes);
+    uint8_t* burst_span(uint64_t addr, uint8_t size, axi_burst_t burst, uint8_t len, uint64_t& start, uint64_t& bytes, size_t& slave_index);
+    void clear_lines();
+    template <typename T>
+    std::optional<uint16_t> select_id(const std::map<uint16_t, std::deque<T>>& queues, uint16_t last_id) const;
+    uint64_t calculate_next_addr(uint64_t base_addr, uint8_t size, axi_burst_t burst, uint8_t len, uint8_t beat);
     void handle_top(const std::unique_ptr<VMarkoRvCore> &top);
     void handle_read(axiSignal &axi);
     void handle_write(axiSignal &axi);
+    void check_write_watches(uint64_t addr, uint64_t data, uint8_t size, uint8_t strb);
 };
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include <verilated_save.h>
+
+#define CHECKPOINT_MAGIC   0x54504b43564f524dULL // "MROVCKPT"
+#define CHECKPOINT_VERSION 5
+
+/**
+ * @brief Serialization helpers shared by the harness components for checkpoint/restore.
+ * Everything goes through the Verilated save stream so the model and the harness share one file.
+ */
+template <typename T>
+requires std::is_trivially_copyable_v<T>
+void save_pod(VerilatedSerialize& os, const T& value) {
+    os.write(&value, sizeof(T));
+}
+
+template <typename T>
+requires std::is_trivially_copyable_v<T>
+void restore_pod(VerilatedDeserialize& is, T& value) {
+    is.read(&value, sizeof(T));
+}
+
+template <typename T>
+requires std::is_trivially_copyable_v<T>
+void save_vector(VerilatedSerialize& os, const std::vector<T>& values) {
+    save_pod(os, static_cast<uint64_t>(values.size()));
+    if (!values.empty())
+        os.write(values.data(), values.size() * sizeof(T));
+}
+
+template <typename T>
+requires std::is_trivially_copyable_v<T>
+void restore_vector(VerilatedDeserialize& is, std::vector<T>& values) {
+    uint64_t size = 0;
+    restore_pod(is, size);
+    values.resize(size);
+    if (!values.empty())
+        is.read(values.data(), values.size() * sizeof(T));
+}
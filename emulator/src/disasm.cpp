@@ -0,0 +1,306 @@
+#include "disasm.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <format>
+#include <utility>
+
+// Patterns of one major opcode are grouped, more specific masks first
+static constexpr instrPattern amo(uint32_t funct5, uint32_t funct3, const char* name) {
+    // aq/rl (bits 26:25) are printed as suffixes
+    return {0xf800707f, funct5 << 27 | funct3 << 12 | 0x2f, name, FMT_AMO};
+}
+
+static constexpr instrPattern instr_patterns[] = {
+    // LOAD
+    {0x707f, 0x0003, "lb", FMT_LOAD},
+    {0x707f, 0x1003, "lh", FMT_LOAD},
+    {0x707f, 0x2003, "lw", FMT_LOAD},
+    {0x707f, 0x3003, "ld", FMT_LOAD},
+    {0x707f, 0x4003, "lbu", FMT_LOAD},
+    {0x707f, 0x5003, "lhu", FMT_LOAD},
+    {0x707f, 0x6003, "lwu", FMT_LOAD},
+    // MISC-MEM
+    {0x707f, 0x000f, "fence", FMT_FENCE},
+    {0xffffffff, 0x100f, "fence.i", FMT_NONE},
+    // OP-IMM
+    {0x707f, 0x0013, "addi", FMT_I},
+    {0xfc00707f, 0x1013, "slli", FMT_SHIFT},
+    {0x707f, 0x2013, "slti", FMT_I},
+    {0x707f, 0x3013, "sltiu", FMT_I},
+    {0x707f, 0x4013, "xori", FMT_I},
+    {0xfc00707f, 0x5013, "srli", FMT_SHIFT},
+    {0xfc00707f, 0x40005013, "srai", FMT_SHIFT},
+    {0x707f, 0x6013, "ori", FMT_I},
+    {0x707f, 0x7013, "andi", FMT_I},
+    // AUIPC
+    {0x7f, 0x17, "auipc", FMT_U},
+    // OP-IMM-32
+    {0x707f, 0x001b, "addiw", FMT_I},
+    {0xfe00707f, 0x101b, "slliw", FMT_SHIFT},
+    {0xfe00707f, 0x501b, "srliw", FMT_SHIFT},
+    {0xfe00707f, 0x4000501b, "sraiw", FMT_SHIFT},
+    // STORE
+    {0x707f, 0x0023, "sb", FMT_STORE},
+    {0x707f, 0x1023, "sh", FMT_STORE},
+    {0x707f, 0x2023, "sw", FMT_STORE},
+    {0x707f, 0x3023, "sd", FMT_STORE},
+    // AMO
+    {0xf9f0707f, 0x1000202f, "lr.w", FMT_LR},
+    {0xf9f0707f, 0x1000302f, "lr.d", FMT_LR},
+    amo(0x03, 2, "sc.w"), amo(0x03, 3, "sc.d"),
+    amo(0x01, 2, "amoswap.w"), amo(0x01, 3, "amoswap.d"),
+    amo(0x00, 2, "amoadd.w"), amo(0x00, 3, "amoadd.d"),
+    amo(0x04, 2, "amoxor.w"), amo(0x04, 3, "amoxor.d"),
+    amo(0x0c, 2, "amoand.w"), amo(0x0c, 3, "amoand.d"),
+    amo(0x08, 2, "amoor.w"), amo(0x08, 3, "amoor.d"),
+    amo(0x10, 2, "amomin.w"), amo(0x10, 3, "amomin.d"),
+    amo(0x14, 2, "amomax.w"), amo(0x14, 3, "amomax.d"),
+    amo(0x18, 2, "amominu.w"), amo(0x18, 3, "amominu.d"),
+    amo(0x1c, 2, "amomaxu.w"), amo(0x1c, 3, "amomaxu.d"),
+    // OP
+    {0xfe00707f, 0x00000033, "add", FMT_R},
+    {0xfe00707f, 0x40000033, "sub", FMT_R},
+    {0xfe00707f, 0x00001033, "sll", FMT_R},
+    {0xfe00707f, 0x00002033, "slt", FMT_R},
+    {0xfe00707f, 0x00003033, "sltu", FMT_R},
+    {0xfe00707f, 0x00004033, "xor", FMT_R},
+    {0xfe00707f, 0x00005033, "srl", FMT_R},
+    {0xfe00707f, 0x40005033, "sra", FMT_R},
+    {0xfe00707f, 0x00006033, "or", FMT_R},
+    {0xfe00707f, 0x00007033, "and", FMT_R},
+    {0xfe00707f, 0x02000033, "mul", FMT_R},
+    {0xfe00707f, 0x02001033, "mulh", FMT_R},
+    {0xfe00707f, 0x02002033, "mulhsu", FMT_R},
+    {0xfe00707f, 0x02003033, "mulhu", FMT_R},
+    {0xfe00707f, 0x02004033, "div", FMT_R},
+    {0xfe00707f, 0x02005033, "divu", FMT_R},
+    {0xfe00707f, 0x02006033, "rem", FMT_R},
+    {0xfe00707f, 0x02007033, "remu", FMT_R},
+    // LUI
+    {0x7f, 0x37, "lui", FMT_U},
+    // OP-32
+    {0xfe00707f, 0x0000003b, "addw", FMT_R},
+    {0xfe00707f, 0x4000003b, "subw", FMT_R},
+    {0xfe00707f, 0x0000103b, "sllw", FMT_R},
+    {0xfe00707f, 0x0000503b, "srlw", FMT_R},
+    {0xfe00707f, 0x4000503b, "sraw", FMT_R},
+    {0xfe00707f, 0x0200003b, "mulw", FMT_R},
+    {0xfe00707f, 0x0200403b, "divw", FMT_R},
+    {0xfe00707f, 0x0200503b, "divuw", FMT_R},
+    {0xfe00707f, 0x0200603b, "remw", FMT_R},
+    {0xfe00707f, 0x0200703b, "remuw", FMT_R},
+    // BRANCH
+    {0x707f, 0x0063, "beq", FMT_BRANCH},
+    {0x707f, 0x1063, "bne", FMT_BRANCH},
+    {0x707f, 0x4063, "blt", FMT_BRANCH},
+    {0x707f, 0x5063, "bge", FMT_BRANCH},
+    {0x707f, 0x6063, "bltu", FMT_BRANCH},
+    {0x707f, 0x7063, "bgeu", FMT_BRANCH},
+    // JALR
+    {0x707f, 0x0067, "jalr", FMT_JALR},
+    // JAL
+    {0x7f, 0x6f, "jal", FMT_JAL},
+    // SYSTEM
+    {0xffffffff, 0x00000073, "ecall", FMT_NONE},
+    {0xffffffff, 0x00100073, "ebreak", FMT_NONE},
+    {0xffffffff, 0x10200073, "sret", FMT_NONE},
+    {0xffffffff, 0x30200073, "mret", FMT_NONE},
+    {0xffffffff, 0x10500073, "wfi", FMT_NONE},
+    {0x707f, 0x1073, "csrrw", FMT_CSR},
+    {0x707f, 0x2073, "csrrs", FMT_CSR},
+    {0x707f, 0x3073, "csrrc", FMT_CSR},
+    {0x707f, 0x5073, "csrrwi", FMT_CSRI},
+    {0x707f, 0x6073, "csrrsi", FMT_CSRI},
+    {0x707f, 0x7073, "csrrci", FMT_CSRI},
+};
+
+static constexpr size_t major_opcode(uint32_t raw) {
+    return (raw >> 2) & 0x1f;
+}
+
+// [first, last) of the patterns of each major opcode (bits 6:2)
+static constexpr auto opcode_ranges = [] {
+    std::array<std::pair<uint8_t, uint8_t>, 32> ranges{};
+    for (size_t i = 0; i < std::size(instr_patterns); i++) {
+        auto& range = ranges[major_opcode(instr_patterns[i].match)];
+        if (range.first == range.second)
+            range.first = static_cast<uint8_t>(i);
+        range.second = static_cast<uint8_t>(i + 1);
+    }
+    return ranges;
+}();
+
+static constexpr bool patterns_grouped() {
+    for (const auto& [first, last] : opcode_ranges) {
+        for (size_t i = first; i < last; i++) {
+            if (major_opcode(instr_patterns[i].match) != major_opcode(instr_patterns[first].match))
+                return false;
+        }
+    }
+    return std::size(instr_patterns) < 256;
+}
+static_assert(patterns_grouped(), "instr_patterns must be grouped by major opcode");
+
+static constexpr const char* reg_names[32] = {
+    "zero", "ra", "sp", "gp", "tp", "t0", "t1", "t2", "s0", "s1", "a0", "a1", "a2", "a3", "a4", "a5",
+    "a6", "a7", "s2", "s3", "s4", "s5", "s6", "s7", "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6"
+};
+
+static constexpr std::pair<uint16_t, const char*> csr_names[] = {
+    {0x100, "sstatus"}, {0x104, "sie"}, {0x105, "stvec"}, {0x140, "sscratch"}, {0x141, "sepc"},
+    {0x142, "scause"}, {0x143, "stval"}, {0x144, "sip"}, {0x180, "satp"},
+    {0x300, "mstatus"}, {0x301, "misa"}, {0x302, "medeleg"}, {0x303, "mideleg"}, {0x304, "mie"},
+    {0x305, "mtvec"}, {0x306, "mcounteren"}, {0x340, "mscratch"}, {0x341, "mepc"}, {0x342, "mcause"},
+    {0x343, "mtval"}, {0x344, "mip"}, {0xb00, "mcycle"}, {0xb02, "minstret"},
+    {0xc00, "cycle"}, {0xc01, "time"}, {0xc02, "instret"},
+    {0xf11, "mvendorid"}, {0xf12, "marchid"}, {0xf13, "mimpid"}, {0xf14, "mhartid"}, {0xf15, "mconfigptr"}
+};
+
+static std::string csr_name(uint32_t csr) {
+    auto it = std::ranges::find(csr_names, csr, &std::pair<uint16_t, const char*>::first);
+    return it != std::end(csr_names) ? it->second : std::format("0x{:x}", csr);
+}
+
+static int64_t sign_extend(uint64_t value, unsigned bits) {
+    const unsigned shift = 64 - bits;
+    return static_cast<int64_t>(value << shift) >> shift;
+}
+
+decodedInstr decode_instr(uint32_t raw) {
+    decodedInstr instr;
+    if ((raw & 3) != 3)
+        return instr;
+    const auto [first, last] = opcode_ranges[major_opcode(raw)];
+    for (size_t i = first; i < last; i++) {
+        if ((raw & instr_patterns[i].mask) == instr_patterns[i].match) {
+            instr.pattern = &instr_patterns[i];
+            break;
+        }
+    }
+    if (!instr.pattern)
+        return instr;
+
+    instr.rd = (raw >> 7) & 0x1f;
+    instr.rs1 = (raw >> 15) & 0x1f;
+    instr.rs2 = (raw >> 20) & 0x1f;
+    switch (instr.pattern->format) {
+        case FMT_I:
+        case FMT_LOAD:
+        case FMT_JALR:
+            instr.imm = sign_extend(raw >> 20, 12);
+            break;
+        case FMT_SHIFT:
+            instr.imm = (raw >> 20) & 0x3f;
+            break;
+        case FMT_STORE:
+            instr.imm = sign_extend((raw >> 25) << 5 | ((raw >> 7) & 0x1f), 12);
+            break;
+        case FMT_BRANCH:
+            instr.imm = sign_extend(((raw >> 31) & 1) << 12 | ((raw >> 7) & 1) << 11 | ((raw >> 25) & 0x3f) << 5 |
+                                    ((raw >> 8) & 0xf) << 1, 13);
+            break;
+        case FMT_U:
+            instr.imm = raw >> 12;
+            break;
+        case FMT_JAL:
+            instr.imm = sign_extend(((raw >> 31) & 1) << 20 | ((raw >> 12) & 0xff) << 12 | ((raw >> 20) & 1) << 11 |
+                                    ((raw >> 21) & 0x3ff) << 1, 21);
+            break;
+        case FMT_CSR:
+            instr.imm = raw >> 20;
+            break;
+        case FMT_CSRI:
+            instr.imm = (raw >> 20) << 5 | instr.rs1;
+            break;
+        case FMT_FENCE:
+            instr.imm = (raw >> 20) & 0xff;
+            break;
+        default:
+            break;
+    }
+    return instr;
+}
+
+static std::string fence_set(uint32_t bits) {
+    std::string set;
+    for (int i = 3; i >= 0; i--) {
+        if (bits >> i & 1)
+            set += "iorw"[3 - i];
+    }
+    return set.empty() ? "0" : set;
+}
+
+std::string disassemble(uint64_t pc, uint32_t raw) {
+    const decodedInstr instr = decode_instr(raw);
+    if (!instr.pattern)
+        return "unknown";
+    const std::string_view name = instr.pattern->name;
+    const char* rd = reg_names[instr.rd];
+    const char* rs1 = reg_names[instr.rs1];
+    const char* rs2 = reg_names[instr.rs2];
+
+    switch (instr.pattern->format) {
+        case FMT_NONE:
+            return std::string(name);
+        case FMT_R:
+            return std::format("{} {}, {}, {}", name, rd, rs1, rs2);
+        case FMT_I:
+            // The common pseudo instructions of the assembler
+            if (name == "addi" && instr.rd == 0 && instr.rs1 == 0 && instr.imm == 0)
+                return "nop";
+            if (name == "addi" && instr.rs1 == 0)
+                return std::format("li {}, {}", rd, instr.imm);
+            if (name == "addi" && instr.imm == 0)
+                return std::format("mv {}, {}", rd, rs1);
+            if (name == "addiw" && instr.imm == 0)
+                return std::format("sext.w {}, {}", rd, rs1);
+            return std::format("{} {}, {}, {}", name, rd, rs1, instr.imm);
+        case FMT_SHIFT:
+            return std::format("{} {}, {}, {}", name, rd, rs1, instr.imm);
+        case FMT_LOAD:
+            return std::format("{} {}, {}({})", name, rd, instr.imm, rs1);
+        case FMT_STORE:
+            return std::format("{} {}, {}({})", name, rs2, instr.imm, rs1);
+        case FMT_BRANCH:
+            if (instr.rs2 == 0 && (name == "beq" || name == "bne"))
+                return std::format("{}z {}, 0x{:x}", name, rs1, pc + instr.imm);
+            return std::format("{} {}, {}, 0x{:x}", name, rs1, rs2, pc + instr.imm);
+        case FMT_U:
+            return std::format("{} {}, 0x{:x}", name, rd, instr.imm);
+        case FMT_JAL:
+            if (instr.rd == 0)
+                return std::format("j 0x{:x}", pc + instr.imm);
+            if (instr.rd == 1)
+                return std::format("jal 0x{:x}", pc + instr.imm);
+            return std::format("jal {}, 0x{:x}", rd, pc + instr.imm);
+        case FMT_JALR:
+            if (instr.rd == 0 && instr.rs1 == 1 && instr.imm == 0)
+                return "ret";
+            if (instr.rd == 0 && instr.imm == 0)
+                return std::format("jr {}", rs1);
+            return std::format("jalr {}, {}({})", rd, instr.imm, rs1);
+        case FMT_CSR:
+            if (name == "csrrs" && instr.rs1 == 0)
+                return std::format("csrr {}, {}", rd, csr_name(instr.imm));
+            if (name == "csrrw" && instr.rd == 0)
+                return std::format("csrw {}, {}", csr_name(instr.imm), rs1);
+            return std::format("{} {}, {}, {}", name, rd, csr_name(instr.imm), rs1);
+        case FMT_CSRI:
+            return std::format("{} {}, {}, {}", name, rd, csr_name(instr.imm >> 5), instr.imm & 0x1f);
+        case FMT_AMO:
+        case FMT_LR: {
+            static constexpr const char* orderings[] = {"", ".rl", ".aq", ".aqrl"};
+            const char* suffix = orderings[(raw >> 25) & 3];
+            if (instr.pattern->format == FMT_LR)
+                return std::format("{}{} {}, ({})", name, suffix, rd, rs1);
+            return std::format("{}{} {}, {}, ({})", name, suffix, rd, rs2, rs1);
+        }
+        case FMT_FENCE:
+            return std::format("fence {}, {}", fence_set(instr.imm >> 4), fence_set(instr.imm & 0xf));
+    }
+    return "unknown";
+}
+
+DisasmCache::DisasmCache(size_t size) : entries(std::bit_ceil(std::max<size_t>(size, 1))), mask(entries.size() - 1) {}
@@ -0,0 +1,72 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Operand layout of an instruction pattern
+enum instr_format_t : uint8_t {
+    FMT_NONE,    // ecall, mret, ...
+    FMT_R,       // rd, rs1, rs2
+    FMT_I,       // rd, rs1, imm
+    FMT_SHIFT,   // rd, rs1, shamt
+    FMT_LOAD,    // rd, imm(rs1)
+    FMT_STORE,   // rs2, imm(rs1)
+    FMT_BRANCH,  // rs1, rs2, target
+    FMT_U,       // rd, imm20
+    FMT_JAL,     // rd, target
+    FMT_JALR,    // rd, imm(rs1)
+    FMT_CSR,     // rd, csr, rs1
+    FMT_CSRI,    // rd, csr, uimm
+    FMT_AMO,     // rd, rs2, (rs1)
+    FMT_LR,      // rd, (rs1)
+    FMT_FENCE    // pred, succ
+};
+
+struct instrPattern {
+    uint32_t mask;
+    uint32_t match;
+    const char* name;
+    instr_format_t format;
+};
+
+struct decodedInstr {
+    const instrPattern* pattern = nullptr;  // nullptr for encodings outside RV64IMA+Zicsr
+    uint8_t rd = 0;
+    uint8_t rs1 = 0;
+    uint8_t rs2 = 0;
+    int64_t imm = 0;                        // Sign extended, shamt, csr << 5 | uimm of FMT_CSRI
+};
+
+// Table lookup of the RV64IMA+Zicsr encoding of raw
+decodedInstr decode_instr(uint32_t raw);
+// Assembly text with ABI register names and absolute branch targets, "unknown" for other encodings
+std::string disassemble(uint64_t pc, uint32_t raw);
+
+/**
+ * @brief Direct-mapped cache of disassembled instructions keyed by (pc, raw instruction).
+ * Hot loops hit the same few PCs, a hit is a compare and a reference to the cached text.
+ */
+class DisasmCache {
+public:
+    // size is rounded up to a power of two
+    explicit DisasmCache(size_t size = 0x1000);
+
+    const std::string& get(uint64_t pc, uint32_t raw) {
+        cacheEntry& entry = entries[(pc >> 2) & mask];
+        if (!entry.valid || entry.pc != pc || entry.raw != raw) {
+            entry = {pc, raw, true, disassemble(pc, raw)};
+        }
+        return entry.text;
+    }
+
+private:
+    struct cacheEntry {
+        uint64_t pc = 0;
+        uint32_t raw = 0;
+        bool valid = false;
+        std::string text;
+    };
+
+    std::vector<cacheEntry> entries;
+    size_t mask;
+};
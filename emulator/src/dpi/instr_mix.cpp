@@ -0,0 +1,196 @@
+#include "instr_mix.hpp"
+
+#include <algorithm>
+#include <format>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+static constexpr const char* exu_names[] = {"ALU", "BRU", "LSU", "MDU", "MISC"};
+
+void InstrMixStats::sample(const DpiManager& dpi) {
+    for (size_t i = 0; i < CFG_RS_SIZE; i++) {
+        const auto& entry = dpi.rs_data[i];
+        auto& prev = rs_prev[i];
+        const uint8_t rob_index = entry.params.rob_index.value;
+        const uint64_t pc = entry.params.pc.value;
+        if (entry.valid && (!prev.valid || prev.rob_index != rob_index || prev.pc != pc)) {
+            const uint16_t key = op_key(entry);
+            ops[key].issued++;
+            if (entry.exu.value < exus.size())
+                exus[entry.exu.value].issued++;
+            if (rob_index < CFG_ROB_SIZE)
+                rob_ops[rob_index] = {pc, key};
+        }
+        prev = {static_cast<bool>(entry.valid), rob_index, pc};
+    }
+
+    // Every retirement bumps the count of the update_retire hook
+    if (dpi.retire_count != retires_seen) {
+        retires_seen = dpi.retire_count;
+        const auto& head = dpi.last_retire;
+        auto& op = rob_ops[head.index];
+        if (op.key != UNKNOWN_OP && op.pc == head.pc)
+            ops[op.key].retired++;
+        else
+            unknown_retired++;
+        if (head.exu < exus.size())
+            exus[head.exu].retired++;
+        if (head.trap)
+            traps++;
+        op.key = UNKNOWN_OP;
+    }
+}
+
+uint16_t InstrMixStats::op_key(const ReservationStationEntry& entry) {
+    const auto& op = entry.opcodes;
+    uint16_t fields = 0;
+    switch (entry.exu.value) {
+        case EXUEnum::ALU: fields = op.alu_op.funct3.value | op.alu_op.sra_sub.value << 3 | op.alu_op.op32.value << 4; break;
+        case EXUEnum::BRU: fields = op.bru_op.funct.value; break;
+        case EXUEnum::LSU: fields = op.lsu_op.funct.value | op.lsu_op.size.value << 6; break;
+        case EXUEnum::MDU: fields = op.mdu_op.funct3.value | op.mdu_op.op32.value << 3; break;
+        case EXUEnum::MISC:
+            fields = op.misc_op.misc_csr_funct.value | op.misc_op.misc_sys_funct.value << 4 | op.misc_op.misc_mem_funct.value << 7;
+            break;
+        default: break;
+    }
+    return static_cast<uint16_t>(entry.exu.value << 12 | fields);
+}
+
+std::string InstrMixStats::op_name(uint16_t key) {
+    static constexpr const char* alu_names[] = {"add", "sll", "slt", "sltu", "xor", "srl", "or", "and"};
+    static constexpr const char* mdu_names[] = {"mul", "mulh", "mulhsu", "mulhu", "div", "divu", "rem", "remu"};
+    static constexpr const char sizes[] = {'b', 'h', 'w', 'd'};
+    const uint16_t fields = key & 0xfff;
+
+    switch (key >> 12) {
+        case EXUEnum::ALU: {
+            const uint8_t funct3 = fields & 0x7;
+            std::string name = alu_names[funct3];
+            if (fields & 0x8)
+                name = funct3 == 0 ? "sub" : "sra";
+            return fields & 0x10 ? name + "w" : name;
+        }
+        case EXUEnum::BRU: {
+            static const std::map<uint16_t, const char*> names = {
+                {0, "beq"}, {1, "bne"}, {4, "blt"}, {5, "bge"}, {6, "bltu"}, {7, "bgeu"}, {8, "jal"}, {9, "jalr"}
+            };
+            auto it = names.find(fields);
+            return it != names.end() ? it->second : std::format("bru.{:x}", fields);
+        }
+        case EXUEnum::LSU: {
+            static const std::map<uint16_t, const char*> amo_names = {
+                {0x01, "amoadd"}, {0x03, "amoswap"}, {0x05, "lr"}, {0x07, "sc"}, {0x09, "amoxor"}, {0x11, "amoor"},
+                {0x19, "amoand"}, {0x21, "amomin"}, {0x29, "amomax"}, {0x31, "amominu"}, {0x39, "amomaxu"}
+            };
+            const uint16_t funct = fields & 0x3f;
+            const uint16_t size = fields >> 6;
+            if (funct == 0x00)
+                return std::format("l{}{}", sizes[size & 0x3], size & 0x4 ? "u" : "");
+            if (funct == 0x02)
+                return std::format("s{}", sizes[size & 0x3]);
+            auto it = amo_names.find(funct);
+            return it != amo_names.end() ? std::format("{}.{}", it->second, sizes[size & 0x3]) : std::format("lsu.{:x}", funct);
+        }
+        case EXUEnum::MDU: {
+            std::string name = mdu_names[fields & 0x7];
+            return fields & 0x8 ? name + "w" : name;
+        }
+        case EXUEnum::MISC: {
+            static constexpr const char* csr_names[] = {"", "csrrw", "csrrs", "csrrc"};
+            static constexpr const char* sys_names[] = {"", "ecall", "ebreak", "wfi", "mret"};
+            const uint16_t csr = fields & 0xf;
+            const uint16_t sys = (fields >> 4) & 0x7;
+            if (csr & 0x3)
+                return csr_names[csr & 0x3];
+            if (sys > 0 && sys < std::size(sys_names))
+                return sys_names[sys];
+            if (((fields >> 7) & 0x3) == 2)
+                return "fence.i";
+            return "misc";
+        }
+        default:
+            return std::format("exu{}.{:x}", key >> 12, fields);
+    }
+}
+
+const char* InstrMixStats::op_class(uint16_t key) {
+    const uint16_t fields = key & 0xfff;
+    switch (key >> 12) {
+        case EXUEnum::ALU: return "integer";
+        case EXUEnum::BRU: return fields >= 8 ? "jump" : "branch";
+        case EXUEnum::LSU:
+            if ((fields & 0x3f) == 0x00) return "load";
+            if ((fields & 0x3f) == 0x02) return "store";
+            return "atomic";
+        case EXUEnum::MDU: return fields & 0x4 ? "divide" : "multiply";
+        case EXUEnum::MISC:
+            if (fields & 0x3) return "csr";
+            if ((fields >> 4) & 0x7) return "system";
+            return "fence";
+        default: return "unknown";
+    }
+}
+
+void InstrMixStats::write_json(const std::string& path) const {
+    std::ofstream file(path);
+    if (!file)
+        throw std::runtime_error("Can't open instruction mix file: " + path);
+
+    opCounts total;
+    std::map<std::string, opCounts> classes;
+    std::map<uint64_t, std::pair<uint64_t, uint64_t>> mem_sizes; // bytes -> retired loads, stores
+    std::map<std::string, opCounts> by_name;
+    for (const auto& [key, counts] : ops) {
+        total.issued += counts.issued;
+        total.retired += counts.retired;
+        auto& cls = classes[op_class(key)];
+        cls.issued += counts.issued;
+        cls.retired += counts.retired;
+        if (key >> 12 == EXUEnum::LSU && ((key & 0x3f) == 0x00 || (key & 0x3f) == 0x02)) {
+            auto& [loads, stores] = mem_sizes[1ull << ((key >> 6) & 0x3)];
+            ((key & 0x3f) == 0x00 ? loads : stores) += counts.retired;
+        }
+        auto& op = by_name[op_name(key)];
+        op.issued += counts.issued;
+        op.retired += counts.retired;
+    }
+    std::vector<std::pair<std::string, opCounts>> named(by_name.begin(), by_name.end());
+    std::ranges::sort(named, [](const auto& a, const auto& b) {
+        return std::tie(b.second.retired, b.second.issued, a.first) < std::tie(a.second.retired, a.second.issued, b.first);
+    });
+
+    auto counts_json = [](const opCounts& counts) {
+        return std::format("{{\"issued\": {}, \"retired\": {}}}", counts.issued, counts.retired);
+    };
+
+    file << std::format("{{\n  \"issued\": {},\n  \"retired\": {},\n  \"retired_unclassified\": {},\n  \"traps\": {}",
+                        total.issued, total.retired + unknown_retired, unknown_retired, traps);
+
+    file << ",\n  \"exu\": {";
+    for (size_t i = 0; i < exus.size(); i++) {
+        file << std::format("{}\n    \"{}\": {}", i ? "," : "", exu_names[i], counts_json(exus[i]));
+    }
+    file << "\n  },\n  \"classes\": {";
+    bool first = true;
+    for (const auto& [name, counts] : classes) {
+        file << std::format("{}\n    \"{}\": {}", first ? "" : ",", name, counts_json(counts));
+        first = false;
+    }
+    file << "\n  },\n  \"mem_sizes\": {";
+    first = true;
+    for (const auto& [bytes, counts] : mem_sizes) {
+        file << std::format("{}\n    \"{}\": {{\"loads\": {}, \"stores\": {}}}", first ? "" : ",", bytes, counts.first, counts.second);
+        first = false;
+    }
+    file << "\n  },\n  \"ops\": {";
+    first = true;
+    for (const auto& [name, counts] : named) {
+        file << std::format("{}\n    \"{}\": {}", first ? "" : ",", name, counts_json(counts));
+        first = false;
+    }
+    file << "\n  }\n}\n";
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "manager.hpp"
+
+/**
+ * @brief Instruction mix derived from the RS snapshots and the retirements of the DPI hooks.
+ * An instruction is issued when it shows up in a reservation station entry, its opcode bundle is remembered by ROB index.
+ * It retires when update_retire reports its ROB entry, squashed instructions are therefore only counted as issued.
+ */
+class InstrMixStats {
+public:
+    // Retirements reported before construction are not counted
+    explicit InstrMixStats(const DpiManager& dpi) : retires_seen(dpi.retire_count) {}
+
+    // Diff the structures once per cycle after the posedge
+    void sample(const DpiManager& dpi);
+    void write_json(const std::string& path) const;
+
+    // Compact opcode of an RS entry: exu << 12 | the opcode fields of that EXU
+    static uint16_t op_key(const ReservationStationEntry& entry);
+    static std::string op_name(uint16_t key);
+
+private:
+    struct opCounts {
+        uint64_t issued = 0;
+        uint64_t retired = 0;
+    };
+
+    struct rsSlot {
+        bool valid = false;
+        uint8_t rob_index = 0;
+        uint64_t pc = 0;
+    };
+
+    // Op key of the ROB entry, UNKNOWN_OP when it never passed a reservation station
+    struct robOp {
+        uint64_t pc = 0;
+        uint16_t key = UNKNOWN_OP;
+    };
+
+    static constexpr uint16_t UNKNOWN_OP = UINT16_MAX;
+
+    std::unordered_map<uint16_t, opCounts> ops;
+    std::array<opCounts, 5> exus{};
+    uint64_t unknown_retired = 0;
+    uint64_t traps = 0;
+
+    std::array<rsSlot, CFG_RS_SIZE> rs_prev{};
+    std::array<robOp, CFG_ROB_SIZE> rob_ops{};
+    uint64_t retires_seen;
+
+    static const char* op_class(uint16_t key);
+};
@@ -2,31 +2,61 @@
 #include <iostream>
 #include <format>
 #include <string>
+#include <tuple>
 #include <vector>
 
+thread_local DpiManager* DpiManager::current = nullptr;
+
+DpiManager& DpiManager::get_current() {
+    if (!current) {
+        throw std::runtime_error("DPI callback without a bound DpiManager.");
+    }
+    return *current;
+}
+
+void DpiManager::set_profiler(HostProfiler* profiler) {
+    static constexpr const char* hook_names[HOOK_NUM] = {
+        "update_rob", "update_rs", "update_rt", "update_rf", "update_pc", "update_fetching_instr", "update_wfi",
+        "update_retire", "update_trap"
+    };
+    this->profiler = profiler;
+    if (profiler) {
+        for (size_t i = 0; i < HOOK_NUM; i++) {
+            hook_counters[i] = profiler->add_counter("dpi", hook_names[i]);
+        }
+    }
+}
+
 extern "C" {
-    
+
 void update_rob(const svBitVecVal* entry, const uint32_t index) {
+    DpiManager& dpi_manager = DpiManager::get_current();
+    auto scope = dpi_manager.profile(HOOK_ROB);
     auto decoded_entry = bytes_to_struct<robEntry>(entry);
 
     if (index < CFG_ROB_SIZE) {
-        rob_data[index] = decoded_entry;
+        dpi_manager.rob_data[index] = decoded_entry;
     } else {
         throw std::runtime_error("Rob index out of range.");
     }
 }
 
 void update_rs(const svBitVecVal* entry, const uint32_t index) {
+    DpiManager& dpi_manager = DpiManager::get_current();
+    auto scope = dpi_manager.profile(HOOK_RS);
     auto decoded_entry = bytes_to_struct<ReservationStationEntry>(entry);
 
-    if (index < CFG_ROB_SIZE) {
-        rs_data[index] = decoded_entry;
+    if (index < CFG_RS_SIZE) {
+        dpi_manager.rs_data[index] = decoded_entry;
     } else {
         throw std::runtime_error("Rs index out of range.");
     }
 }
 
 void update_rt(const svOpenArrayHandle handle, const uint32_t rt_index) {
+    DpiManager& dpi_manager = DpiManager::get_current();
+    auto scope = dpi_manager.profile(HOOK_RT);
+    auto& rt_data = dpi_manager.rt_data;
     size_t table_index = 0;
     for (int i = 0; i < 31; i++) {
         svGetBitArrElem1VecVal(&rt_data[rt_index][table_index], handle, i);
@@ -35,6 +65,9 @@ void update_rt(const svOpenArrayHandle handle, const uint32_t rt_index) {
 }
 
 void update_rf(const svOpenArrayHandle regs_handle, const svOpenArrayHandle states_handle) {
+    DpiManager& dpi_manager = DpiManager::get_current();
+    auto scope = dpi_manager.profile(HOOK_RF);
+    auto& rf_data = dpi_manager.rf_data;
     for (int i = 0; i < CFG_RF_SIZE; ++i) {
         svBitVecVal data_buffer[2] = {};
         svGetBitArrElem1VecVal(data_buffer, regs_handle, i);
@@ -55,12 +88,38 @@ void update_rf(const svOpenArrayHandle regs_handle, const svOpenArrayHandle stat
 }
 
 void update_pc(uint64_t pc) {
-    DpiManager& dpi_manager = DpiManager::get_instance();
+    DpiManager& dpi_manager = DpiManager::get_current();
+    auto scope = dpi_manager.profile(HOOK_PC);
     dpi_manager.curr_pc = pc;
 }
 
+void update_wfi(bool waiting) {
+    DpiManager& dpi_manager = DpiManager::get_current();
+    auto scope = dpi_manager.profile(HOOK_WFI);
+    dpi_manager.wfi_waiting = waiting;
+}
+
+void update_retire(bool valid, uint32_t index, uint64_t pc, uint32_t exu, bool trap, uint32_t cause, bool recover, bool xret) {
+    DpiManager& dpi_manager = DpiManager::get_current();
+    auto scope = dpi_manager.profile(HOOK_RETIRE);
+    if (!valid)
+        return;
+    dpi_manager.last_retire = {index, pc, static_cast<uint8_t>(exu), trap, static_cast<int16_t>(cause), recover, xret};
+    dpi_manager.retire_count++;
+}
+
+void update_trap(bool valid, bool interrupt, uint32_t cause, uint64_t epc, uint64_t vector) {
+    DpiManager& dpi_manager = DpiManager::get_current();
+    auto scope = dpi_manager.profile(HOOK_TRAP);
+    if (!valid)
+        return;
+    dpi_manager.last_trap = {interrupt, static_cast<uint8_t>(cause), epc, vector};
+    dpi_manager.trap_count++;
+}
+
 void update_fetching_instr(bool valid, uint32_t instr) {
-    DpiManager& dpi_manager = DpiManager::get_instance();
+    DpiManager& dpi_manager = DpiManager::get_current();
+    auto scope = dpi_manager.profile(HOOK_FETCH);
     if (valid) {
         dpi_manager.fetching_instr = instr;
     } else {
@@ -70,144 +129,206 @@ void update_fetching_instr(bool valid, uint32_t instr) {
 
 } // extern "C"
 
-void DpiManager::print_rob() {
-    std::cout << "\n===== Reorder Buffer Status =====\n";
-    std::cout << std::format("{:<5} {:<8} {:<8} {:<16} {:<10} {:<10} {:<10} {:<8}\n",
-                            "Idx", "Valid", "Commit", "PC", "PRD", "Prev_PRD", "EXU", "Recovery");
+static const char* exu_name(uint8_t exu) {
+    switch (exu) {
+        case EXUEnum::ALU: return "ALU";
+        case EXUEnum::BRU: return "BRU";
+        case EXUEnum::LSU: return "LSU";
+        case EXUEnum::MDU: return "MDU";
+        case EXUEnum::MISC: return "MISC";
+        default: return "UNKNOWN";
+    }
+}
 
-    for (size_t i = 0; i < CFG_ROB_SIZE; ++i) {
-        const auto& entry = rob_data[i];
-        std::string exu_type;
-        switch (entry.exu) {
-            case EXUEnum::ALU: exu_type = "ALU"; break;
-            case EXUEnum::BRU: exu_type = "BRU"; break;
-            case EXUEnum::LSU: exu_type = "LSU"; break;
-            case EXUEnum::MDU: exu_type = "MDU"; break;
-            case EXUEnum::MISC: exu_type = "MISC"; break;
-            default: exu_type = "UNKNOWN"; break;
+// The printed columns of an entry, a delta dump shows the entry when they differ from the last dump
+static auto rob_columns(const robEntry& entry) {
+    return std::tuple(entry.valid.value, entry.commited.value, entry.pc.value, entry.prd_valid.value, entry.prd.value,
+                      entry.prev_prd.value, entry.exu.value, entry.f_ctrl.recover.value);
+}
+
+static auto rs_columns(const ReservationStationEntry& entry) {
+    const auto& op = entry.opcodes;
+    return std::tuple(entry.valid.value, entry.exu.value, entry.params.pc.value, entry.reg_req.prs1_valid.value,
+                      entry.reg_req.prs1.value, entry.reg_req.prs2_valid.value, entry.reg_req.prs2.value,
+                      entry.params.source1.value, entry.params.source2.value, entry.pred_taken.value, entry.pred_pc.value,
+                      op.alu_op.funct3.value, op.alu_op.sra_sub.value, op.alu_op.op32.value, op.bru_op.funct.value,
+                      op.bru_op.offset.value, op.lsu_op.funct.value, op.lsu_op.size.value, op.mdu_op.funct3.value,
+                      op.mdu_op.op32.value, op.misc_op.misc_mem_funct.value, op.misc_op.misc_sys_funct.value,
+                      op.misc_op.misc_csr_funct.value);
+}
+
+std::string DpiManager::rob_row(size_t i) const {
+    const auto& entry = rob_data[i];
+    return std::format("{:<5x} {:<8} {:<8} {:#016x} {:<10} {:<10} {:<10} {:<8} {}\n",
+                       i,
+                       entry.valid ? "Y" : "N",
+                       entry.commited ? "Y" : "N",
+                       entry.pc.value,
+                       entry.prd_valid ? std::format("{:#x}", entry.prd.value) : "-",
+                       entry.prd_valid ? std::format("{:#x}", entry.prev_prd.value) : "-",
+                       exu_name(entry.exu),
+                       entry.f_ctrl.recover ? "Y" : "N",
+                       entry.valid ? symbolize(entry.pc.value) : "");
+}
+
+std::string DpiManager::rs_row(size_t i) const {
+    const auto& entry = rs_data[i];
+    std::string row = std::format("{:<5x} {:<8} {:<10} {:#016x} {:<10} {:<10} {:#016x} {:#016x} {}\n",
+                                  i,
+                                  entry.valid ? "Y" : "N",
+                                  exu_name(entry.exu),
+                                  entry.params.pc.value,
+                                  entry.reg_req.prs1_valid ? std::format("{:#x}", entry.reg_req.prs1.value) : "-",
+                                  entry.reg_req.prs2_valid ? std::format("{:#x}", entry.reg_req.prs2.value) : "-",
+                                  entry.params.source1.value,
+                                  entry.params.source2.value,
+                                  entry.valid ? symbolize(entry.params.pc.value) : "");
+
+    switch (entry.exu) {
+        case EXUEnum::ALU: {
+            const auto& op = entry.opcodes.alu_op;
+            row += std::format("    ALU Op: funct3={:#x}, sra_sub={}, op32={}\n",
+                               op.funct3.value,
+                               op.sra_sub ? "Y" : "N",
+                               op.op32 ? "Y" : "N");
+            break;
+        }
+        case EXUEnum::BRU: {
+            const auto& op = entry.opcodes.bru_op;
+            row += std::format("    BRU Op: funct={:#x}, offset={:#x}, pred_taken={}, pred_pc={:#016x}\n",
+                               op.funct.value,
+                               op.offset.value,
+                               entry.pred_taken ? "Y" : "N",
+                               entry.pred_pc.value);
+            break;
+        }
+        case EXUEnum::LSU: {
+            const auto& op = entry.opcodes.lsu_op;
+            row += std::format("    LSU Op: funct={:#x}, size={:#x}\n",
+                               op.funct.value,
+                               op.size.value);
+            break;
+        }
+        case EXUEnum::MDU: {
+            const auto& op = entry.opcodes.mdu_op;
+            row += std::format("    MDU Op: funct3={:#x}, op32={}\n",
+                               op.funct3.value,
+                               op.op32 ? "Y" : "N");
+            break;
         }
-        std::cout << "exu_type:" << static_cast<uint64_t>(entry.exu) << "\n";
-
-        std::cout << std::format("{:<5x} {:<8} {:<8} {:#016x} {:<10} {:<10} {:<10} {:<8}\n",
-                                i,
-                                entry.valid ? "Y" : "N",
-                                entry.commited ? "Y" : "N",
-                                entry.pc.value,
-                                entry.prd_valid ? std::format("{:#x}", entry.prd.value) : "-",
-                                entry.prd_valid ? std::format("{:#x}", entry.prev_prd.value) : "-",
-                                exu_type,
-                                entry.f_ctrl.recover ? "Y" : "N");
+        case EXUEnum::MISC: {
+            const auto& op = entry.opcodes.misc_op;
+            row += std::format("    MISC Op: mem_funct={:#x}, sys_funct={:#x}, csr_funct={:#x}\n",
+                               op.misc_mem_funct.value,
+                               op.misc_sys_funct.value,
+                               op.misc_csr_funct.value);
+            break;
+        }
+        default:
+            break;
     }
-    std::cout << "================================\n";
+    return row;
 }
 
-void DpiManager::print_rs() {
-    std::cout << "\n===== Reservation Station Status =====\n";
-    std::cout << std::format("{:<5} {:<8} {:<10} {:<16} {:<10} {:<10} {:<16} {:<16}\n",
-                            "Idx", "Valid", "EXU", "PC", "PRS1", "PRS2", "Source1", "Source2");
+std::string DpiManager::rf_row(size_t i) const {
+    static constexpr const char* state_names[] = {"FREE", "ALLOCATED", "OCCUPIED", "COMMITTED"};
+    const auto& entry = rf_data[i];
+    return std::format("{:<5} {:#018x} {:<10}\n", i, entry.data, entry.state < 4 ? state_names[entry.state] : "UNKNOWN");
+}
 
+// Nothing is printed for a delta dump without changes
+void DpiManager::print_rob(uint64_t cycle, bool delta) {
+    std::string rows;
+    for (size_t i = 0; i < CFG_ROB_SIZE; ++i) {
+        const auto& entry = rob_data[i];
+        const auto& shown = rob_shown[i];
+        // Stale fields of an entry that stays invalid are not a change
+        bool changed = rob_columns(entry) != rob_columns(shown) && (entry.valid || shown.valid);
+        if (!delta || changed)
+            rows += rob_row(i);
+        if (changed)
+            rob_shown[i] = entry;
+    }
+    if (rows.empty())
+        return;
+
+    std::cout << (delta ? std::format("\n===== Reorder Buffer Changes @ {:#x} =====\n", cycle) : "\n===== Reorder Buffer Status =====\n");
+    std::cout << std::format("{:<5} {:<8} {:<8} {:<16} {:<10} {:<10} {:<10} {:<8} {}\n",
+                            "Idx", "Valid", "Commit", "PC", "PRD", "Prev_PRD", "EXU", "Recovery", "Symbol");
+    std::cout << rows << "================================\n";
+}
+
+void DpiManager::print_rs(uint64_t cycle, bool delta) {
+    std::string rows;
     for (size_t i = 0; i < CFG_RS_SIZE; ++i) {
         const auto& entry = rs_data[i];
-        std::string exu_type;
-        switch (entry.exu) {
-            case EXUEnum::ALU: exu_type = "ALU"; break;
-            case EXUEnum::BRU: exu_type = "BRU"; break;
-            case EXUEnum::LSU: exu_type = "LSU"; break;
-            case EXUEnum::MDU: exu_type = "MDU"; break;
-            case EXUEnum::MISC: exu_type = "MISC"; break;
-            default: exu_type = "UNKNOWN"; break;
-        }
+        const auto& shown = rs_shown[i];
+        bool changed = rs_columns(entry) != rs_columns(shown) && (entry.valid || shown.valid);
+        if (!delta || changed)
+            rows += rs_row(i);
+        if (changed)
+            rs_shown[i] = entry;
+    }
+    if (rows.empty())
+        return;
 
-        std::cout << std::format("{:<5x} {:<8} {:<10} {:#016x} {:<10} {:<10} {:#016x} {:#016x}\n",
-                                i,
-                                entry.valid ? "Y" : "N",
-                                exu_type,
-                                entry.params.pc.value,
-                                entry.reg_req.prs1_valid ? std::format("{:#x}", entry.reg_req.prs1.value) : "-",
-                                entry.reg_req.prs2_valid ? std::format("{:#x}", entry.reg_req.prs2.value) : "-",
-                                entry.params.source1.value,
-                                entry.params.source2.value);
-
-
-        switch (entry.exu) {
-            case EXUEnum::ALU: {
-                const auto& op = entry.opcodes.alu_op;
-                std::cout << std::format("    ALU Op: funct3={:#x}, sra_sub={}, op32={}\n",
-                                        op.funct3.value,
-                                        op.sra_sub ? "Y" : "N",
-                                        op.op32 ? "Y" : "N");
-                break;
-            }
-            case EXUEnum::BRU: {
-                const auto& op = entry.opcodes.bru_op;
-                std::cout << std::format("    BRU Op: funct={:#x}, offset={:#x}, pred_taken={}, pred_pc={:#016x}\n",
-                                        op.funct.value,
-                                        op.offset.value,
-                                        entry.pred_taken ? "Y" : "N",
-                                        entry.pred_pc.value);
-                break;
-            }
-            case EXUEnum::LSU: {
-                const auto& op = entry.opcodes.lsu_op;
-                std::cout << std::format("    LSU Op: funct={:#x}, size={:#x}\n",
-                                        op.funct.value,
-                                        op.size.value);
-                break;
-            }
-            case EXUEnum::MDU: {
-                const auto& op = entry.opcodes.mdu_op;
-                std::cout << std::format("    MDU Op: funct3={:#x}, op32={}\n",
-                                        op.funct3.value,
-                                        op.op32 ? "Y" : "N");
-                break;
-            }
-            case EXUEnum::MISC: {
-                const auto& op = entry.opcodes.misc_op;
-                std::cout << std::format("    MISC Op: mem_funct={:#x}, sys_funct={:#x}, csr_funct={:#x}\n",
-                                        op.misc_mem_funct.value,
-                                        op.misc_sys_funct.value,
-                                        op.misc_csr_funct.value);
-                break;
+    std::cout << (delta ? std::format("\n===== Reservation Station Changes @ {:#x} =====\n", cycle)
+                        : "\n===== Reservation Station Status =====\n");
+    std::cout << std::format("{:<5} {:<8} {:<10} {:<16} {:<10} {:<10} {:<16} {:<16} {}\n",
+                            "Idx", "Valid", "EXU", "PC", "PRS1", "PRS2", "Source1", "Source2", "Symbol");
+    std::cout << rows << "======================================\n";
+}
+
+void DpiManager::print_rt(uint64_t cycle, bool delta) {
+    if (!delta) {
+        std::cout << "\n===== Rename Table Status =====\n";
+        std::cout << "Checkpoint ID: [Register] = Physical Register ID\n";
+        for (size_t checkpoint = 0; checkpoint < CFG_RT_SIZE; ++checkpoint) {
+            std::cout << std::format("\nCheckpoint {:#x}:\n", checkpoint);
+            for (size_t reg = 1; reg <= 31; reg += 8) {
+                std::cout << "  ";
+                for (size_t i = 0; i < 8 && (reg + i) <= 31; ++i) {
+                    std::cout << std::format("x{:<2}={:#04x} ", reg + i, rt_data[checkpoint][reg + i - 1]);
+                }
+                std::cout << "\n";
             }
-            default:
-                break;
         }
+        std::cout << "===============================\n";
+        rt_shown = rt_data;
+        return;
     }
-    std::cout << "======================================\n";
-}
 
-void DpiManager::print_rt() {
-    std::cout << "\n===== Rename Table Status =====\n";
-    std::cout << "Checkpoint ID: [Register] = Physical Register ID\n";
+    std::string rows;
     for (size_t checkpoint = 0; checkpoint < CFG_RT_SIZE; ++checkpoint) {
-        std::cout << std::format("\nCheckpoint {:#x}:\n", checkpoint);
-        for (size_t reg = 1; reg <= 31; reg += 8) {
-            std::cout << "  ";
-            for (size_t i = 0; i < 8 && (reg + i) <= 31; ++i) {
-                std::cout << std::format("x{:<2}={:#04x} ", reg + i, rt_data[checkpoint][reg + i - 1]);
-            }
-            std::cout << "\n";
+        if (rt_data[checkpoint] == rt_shown[checkpoint])
+            continue;
+        rows += std::format("Checkpoint {:#x}:", checkpoint);
+        for (size_t reg = 1; reg <= 31; ++reg) {
+            if (rt_data[checkpoint][reg - 1] != rt_shown[checkpoint][reg - 1])
+                rows += std::format(" x{}={:#04x}", reg, rt_data[checkpoint][reg - 1]);
         }
+        rows += "\n";
+        rt_shown[checkpoint] = rt_data[checkpoint];
     }
-    std::cout << "===============================\n";
+    if (!rows.empty())
+        std::cout << std::format("\n===== Rename Table Changes @ {:#x} =====\n", cycle) << rows << "===============================\n";
 }
 
-void DpiManager::print_rf() {
-    std::cout << "\n===== Register File Status =====\n";
-    std::cout << std::format("{:<5} {:<18} {:<10}\n", "Idx", "Data", "State");
-
+void DpiManager::print_rf(uint64_t cycle, bool delta) {
+    std::string rows;
     for (size_t i = 0; i < CFG_RF_SIZE; ++i) {
         const auto& entry = rf_data[i];
-        std::string state_str;
-        switch (entry.state) {
-            case PhyRegState::FREE:      state_str = "FREE"; break;
-            case PhyRegState::ALLOCATED: state_str = "ALLOCATED"; break;
-            case PhyRegState::OCCUPIED:  state_str = "OCCUPIED"; break;
-            case PhyRegState::COMMITTED: state_str = "COMMITTED"; break;
-            default:                     state_str = "UNKNOWN"; break;
-        }
-        std::cout << std::format("{:<5} {:#018x} {:<10}\n", i, entry.data, state_str);
+        auto& shown = rf_shown[i];
+        bool changed = entry.data != shown.data || entry.state != shown.state;
+        if (!delta || changed)
+            rows += rf_row(i);
+        if (changed)
+            shown = entry;
     }
+    if (rows.empty())
+        return;
 
-    std::cout << "=================================\n";
+    std::cout << (delta ? std::format("\n===== Register File Changes @ {:#x} =====\n", cycle) : "\n===== Register File Status =====\n");
+    std::cout << std::format("{:<5} {:<18} {:<10}\n", "Idx", "Data", "State");
+    std::cout << rows << "=================================\n";
 }
@@ -1,10 +1,16 @@
+#pragma once
 #include <boost/pfr.hpp>
+#include <array>
+#include <functional>
+#include <string>
+#include <optional>
 #include <iostream>
 #include <format>
 
 #include "svdpi.h"
 #include "verilator_abi.hpp"
 #include "../config.hpp"
+#include "../profiler.hpp"
 
 namespace EXUEnum {
     enum Type : uint8_t {
@@ -83,7 +89,6 @@ struct robEntry {
         return boost::pfr::structure_tie(*this);
     }
 };
-static std::array<robEntry, CFG_ROB_SIZE> rob_data;
 
 struct PhyRegRequests {
     Field<uint8_t, log2_ceil(CFG_RF_SIZE)> prs2;
@@ -182,32 +187,94 @@ struct ReservationStationEntry {
     }
 };
 
-static std::array<ReservationStationEntry, CFG_RS_SIZE> rs_data;
-
-static std::array<std::array<uint32_t, 31>, CFG_RT_SIZE> rt_data;
-
 struct RegisterEntry {
     uint64_t data;
     uint8_t state;
 };
-static std::array<RegisterEntry, CFG_RF_SIZE> rf_data;
 
+// ROB head retired by a posedge, as seen by update_retire
+struct retireEvent {
+    size_t index = 0;
+    uint64_t pc = 0;
+    uint8_t exu = 0;   // EXUEnum::Type
+    bool trap = false;
+    int16_t cause = 0;
+    bool recover = false;
+    bool xret = false;
+};
+
+// Trap or interrupt taken by a posedge, as seen by update_trap
+struct trapEvent {
+    bool interrupt = false;
+    uint8_t cause = 0;
+    uint64_t epc = 0;
+    uint64_t vector = 0;  // Handler fetch resumes at
+};
+
+enum dpi_hook_t { HOOK_ROB, HOOK_RS, HOOK_RT, HOOK_RF, HOOK_PC, HOOK_FETCH, HOOK_WFI, HOOK_RETIRE, HOOK_TRAP, HOOK_NUM };
+
+/**
+ * @brief Per-model sink of the DPI debug callbacks.
+ * The callbacks carry no instance handle, so they are routed to the manager bound on the calling thread.
+ * A model evaluated on one thread therefore needs its manager bound there while it runs.
+ */
 class DpiManager {
 public:
-    uint64_t curr_pc;
+    uint64_t curr_pc = 0;
     std::optional<uint32_t> fetching_instr;
+    bool wfi_waiting = false;
+    // Last retirement and the number of retirements so far, a new one bumps the count
+    retireEvent last_retire{};
+    uint64_t retire_count = 0;
+    // Same for traps and interrupts
+    trapEvent last_trap{};
+    uint64_t trap_count = 0;
+
+    std::array<robEntry, CFG_ROB_SIZE> rob_data{};
+    std::array<ReservationStationEntry, CFG_RS_SIZE> rs_data{};
+    std::array<std::array<uint32_t, 31>, CFG_RT_SIZE> rt_data{};
+    std::array<RegisterEntry, CFG_RF_SIZE> rf_data{};
+
+    class Binding {
+    public:
+        explicit Binding(DpiManager& manager) : previous(current) { current = &manager; }
+        ~Binding() { current = previous; }
+        Binding(const Binding&) = delete;
+        Binding& operator=(const Binding&) = delete;
+    private:
+        DpiManager* previous;
+    };
 
-    static DpiManager& get_instance() {
-        static DpiManager instance;
-        return instance;
-    }
-    void print_rob();
-    void print_rs();
-    void print_rt();
-    void print_rf();
-private:
-    DpiManager() {}
-    ~DpiManager() {}
+    DpiManager() = default;
     DpiManager(const DpiManager&) = delete;
     DpiManager& operator=(const DpiManager&) = delete;
+
+    static DpiManager& get_current();
+    void set_profiler(HostProfiler* profiler);
+    // Turns PCs of the debug dumps into func+off
+    void set_symbolizer(std::function<std::string(uint64_t)> symbolizer) { this->symbolizer = std::move(symbolizer); }
+    HostProfiler::Scope profile(dpi_hook_t hook) {
+        return HostProfiler::Scope(profiler, hook_counters[hook]);
+    }
+    // Full tables, or with delta only the entries that changed since the previous dump of that table
+    void print_rob(uint64_t cycle, bool delta);
+    void print_rs(uint64_t cycle, bool delta);
+    void print_rt(uint64_t cycle, bool delta);
+    void print_rf(uint64_t cycle, bool delta);
+private:
+    static thread_local DpiManager* current;
+    HostProfiler* profiler = nullptr;
+    std::array<size_t, HOOK_NUM> hook_counters{};
+    std::function<std::string(uint64_t)> symbolizer;
+
+    // Structures as of the last debug dump
+    std::array<robEntry, CFG_ROB_SIZE> rob_shown{};
+    std::array<ReservationStationEntry, CFG_RS_SIZE> rs_shown{};
+    std::array<std::array<uint32_t, 31>, CFG_RT_SIZE> rt_shown{};
+    std::array<RegisterEntry, CFG_RF_SIZE> rf_shown{};
+
+    std::string symbolize(uint64_t pc) const { return symbolizer ? symbolizer(pc) : ""; }
+    std::string rob_row(size_t i) const;
+    std::string rs_row(size_t i) const;
+    std::string rf_row(size_t i) const;
 };
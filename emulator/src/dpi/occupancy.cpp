@@ -0,0 +1,144 @@
+#include "occupancy.hpp"
+
+#include <algorithm>
+#include <format>
+#include <stdexcept>
+
+static constexpr const char* exu_names[] = {"alu", "bru", "lsu", "mdu", "misc"};
+static constexpr const char* rf_state_names[] = {"free", "allocated", "occupied", "committed"};
+
+OccupancyStats::OccupancyStats(const std::string& path, uint64_t interval, const DpiManager& dpi)
+    : path(path), file(path), csv(path.ends_with(".csv")), interval(std::max<uint64_t>(interval, 1)), retire_tracker(dpi) {
+    if (!file)
+        throw std::runtime_error("Can't open occupancy file: " + path);
+
+    if (csv) {
+        file << "cycle,cycles,retired,ipc,rob_avg,rob_max,rs_avg,rs_max";
+        for (const auto* state : rf_state_names) {
+            file << std::format(",rf_{}_avg", state);
+        }
+        file << ",rf_free_min";
+        for (const auto* exu : exu_names) {
+            file << std::format(",{}_busy", exu);
+        }
+        file << "\n";
+    } else {
+        file << std::format("{{\n  \"interval\": {},\n  \"rob_size\": {},\n  \"rs_size\": {},\n  \"rf_size\": {},\n  \"series\": [",
+                            this->interval, CFG_ROB_SIZE, CFG_RS_SIZE, CFG_RF_SIZE);
+    }
+}
+
+void OccupancyStats::sample(const DpiManager& dpi, uint64_t cycle, uint64_t cycles) {
+    if (window.cycles == 0)
+        window.start = cycle;
+
+    // ROB entries still in a reservation station haven't been issued to their EXU yet
+    std::array<bool, CFG_ROB_SIZE> waiting{};
+    uint64_t rs = 0;
+    for (const auto& entry : dpi.rs_data) {
+        if (!entry.valid)
+            continue;
+        rs++;
+        if (entry.params.rob_index.value < CFG_ROB_SIZE)
+            waiting[entry.params.rob_index.value] = true;
+    }
+
+    uint64_t rob = 0;
+    std::array<bool, EXU_NUM> busy{};
+    for (size_t i = 0; i < CFG_ROB_SIZE; i++) {
+        const auto& entry = dpi.rob_data[i];
+        if (!entry.valid)
+            continue;
+        rob++;
+        if (!entry.commited && !waiting[i] && entry.exu.value < EXU_NUM)
+            busy[entry.exu.value] = true;
+    }
+
+    std::array<uint64_t, RF_STATES> rf{};
+    for (const auto& reg : dpi.rf_data) {
+        if (reg.state < RF_STATES)
+            rf[reg.state]++;
+    }
+
+    if (retire_tracker.step(dpi))
+        window.retired++;
+
+    window.cycles += cycles;
+    window.rob_sum += rob * cycles;
+    window.rob_max = std::max(window.rob_max, rob);
+    window.rs_sum += rs * cycles;
+    window.rs_max = std::max(window.rs_max, rs);
+    for (size_t i = 0; i < RF_STATES; i++) {
+        window.rf_sum[i] += rf[i] * cycles;
+    }
+    window.rf_free_min = std::min(window.rf_free_min, rf[PhyRegState::FREE]);
+    for (size_t i = 0; i < EXU_NUM; i++) {
+        window.exu_busy[i] += busy[i] * cycles;
+    }
+    rob_histogram[rob] += cycles;
+    rs_histogram[rs] += cycles;
+    rf_free_histogram[rf[PhyRegState::FREE]] += cycles;
+
+    if (window.cycles >= interval)
+        write_window();
+}
+
+void OccupancyStats::write_window() {
+    const double cycles = static_cast<double>(window.cycles);
+    std::string row;
+    if (csv) {
+        row = std::format("{},{},{},{:.4f},{:.2f},{},{:.2f},{}", window.start, window.cycles, window.retired,
+                          window.retired / cycles, window.rob_sum / cycles, window.rob_max, window.rs_sum / cycles, window.rs_max);
+        for (const auto sum : window.rf_sum) {
+            row += std::format(",{:.2f}", sum / cycles);
+        }
+        row += std::format(",{}", window.rf_free_min);
+        for (const auto busy : window.exu_busy) {
+            row += std::format(",{:.4f}", busy / cycles);
+        }
+        file << row << "\n";
+    } else {
+        row = std::format("{}\n    {{\"cycle\": {}, \"cycles\": {}, \"retired\": {}, \"ipc\": {:.4f}, "
+                          "\"rob_avg\": {:.2f}, \"rob_max\": {}, \"rs_avg\": {:.2f}, \"rs_max\": {}",
+                          first_row ? "" : ",", window.start, window.cycles, window.retired, window.retired / cycles,
+                          window.rob_sum / cycles, window.rob_max, window.rs_sum / cycles, window.rs_max);
+        for (size_t i = 0; i < RF_STATES; i++) {
+            row += std::format(", \"rf_{}_avg\": {:.2f}", rf_state_names[i], window.rf_sum[i] / cycles);
+        }
+        row += std::format(", \"rf_free_min\": {}", window.rf_free_min);
+        for (size_t i = 0; i < EXU_NUM; i++) {
+            row += std::format(", \"{}_busy\": {:.4f}", exu_names[i], window.exu_busy[i] / cycles);
+        }
+        file << row << "}";
+    }
+    first_row = false;
+    window = {};
+}
+
+void OccupancyStats::finish() {
+    if (window.cycles)
+        write_window();
+
+    if (csv) {
+        std::ofstream hist(path + ".hist.csv");
+        if (!hist)
+            throw std::runtime_error("Can't open occupancy file: " + path + ".hist.csv");
+        hist << "entries,rob_cycles,rs_cycles,rf_free_cycles\n";
+        const size_t rows = std::max({rob_histogram.size(), rs_histogram.size(), rf_free_histogram.size()});
+        auto at = [](const std::vector<uint64_t>& histogram, size_t i) { return i < histogram.size() ? histogram[i] : 0; };
+        for (size_t i = 0; i < rows; i++) {
+            hist << std::format("{},{},{},{}\n", i, at(rob_histogram, i), at(rs_histogram, i), at(rf_free_histogram, i));
+        }
+    } else {
+        auto list = [](const std::vector<uint64_t>& histogram) {
+            std::string text;
+            for (const auto count : histogram) {
+                text += std::format("{}{}", text.empty() ? "" : ", ", count);
+            }
+            return text;
+        };
+        file << std::format("\n  ],\n  \"rob_histogram\": [{}],\n  \"rs_histogram\": [{}],\n  \"rf_free_histogram\": [{}]\n}}\n",
+                            list(rob_histogram), list(rs_histogram), list(rf_free_histogram));
+    }
+    file.close();
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "manager.hpp"
+#include "rob_tracker.hpp"
+
+/**
+ * @brief Time series of ROB/RS/RF occupancy, IPC and EXU activity.
+ * Every cycle folds the DPI snapshots into the current window, a row is written each interval cycles.
+ * The output is CSV when the path ends in .csv (histograms then go to <path>.hist.csv), JSON otherwise.
+ */
+class OccupancyStats {
+public:
+    OccupancyStats(const std::string& path, uint64_t interval, const DpiManager& dpi);
+
+    // Snapshot of the DPI structures held for cycles cycles starting at cycle
+    void sample(const DpiManager& dpi, uint64_t cycle, uint64_t cycles = 1);
+    // Writes the partial last window and the histograms
+    void finish();
+
+private:
+    static constexpr size_t EXU_NUM = 5;
+    static constexpr size_t RF_STATES = 4; // PhyRegState
+
+    struct occupancyWindow {
+        uint64_t start = 0;
+        uint64_t cycles = 0;
+        uint64_t retired = 0;
+        uint64_t rob_sum = 0;
+        uint64_t rob_max = 0;
+        uint64_t rs_sum = 0;
+        uint64_t rs_max = 0;
+        std::array<uint64_t, RF_STATES> rf_sum{};
+        uint64_t rf_free_min = UINT64_MAX;
+        std::array<uint64_t, EXU_NUM> exu_busy{};
+    };
+
+    std::string path;
+    std::ofstream file;
+    bool csv;
+    uint64_t interval;
+    bool first_row = true;
+
+    occupancyWindow window;
+    std::vector<uint64_t> rob_histogram = std::vector<uint64_t>(CFG_ROB_SIZE + 1);
+    std::vector<uint64_t> rs_histogram = std::vector<uint64_t>(CFG_RS_SIZE + 1);
+    std::vector<uint64_t> rf_free_histogram = std::vector<uint64_t>(CFG_RF_SIZE + 1);
+    RobRetireTracker retire_tracker;
+
+    void write_window();
+};
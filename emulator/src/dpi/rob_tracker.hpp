@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+
+#include "manager.hpp"
+
+/**
+ * @brief Hands out each retirement reported by the update_retire hook once.
+ * The ROB retires at most its head per cycle. Skipped idle cycles sample the same DPI state again,
+ * the retire count tells a new retirement from the one still held.
+ */
+class RobRetireTracker {
+public:
+    // Retirements reported before construction, e.g. by an earlier job on the same model, are not handed out
+    explicit RobRetireTracker(const DpiManager& dpi) : seen(dpi.retire_count) {}
+
+    // The entry retired since the previous call
+    std::optional<retireEvent> step(const DpiManager& dpi) {
+        if (dpi.retire_count == seen)
+            return std::nullopt;
+        seen = dpi.retire_count;
+        return dpi.last_retire;
+    }
+
+private:
+    uint64_t seen;
+};
@@ -0,0 +1,71 @@
+#include "trace_deltas.hpp"
+
+#include <algorithm>
+
+#include "instr_mix.hpp"
+
+DpiDeltaTracker::deltaData DpiDeltaTracker::pack_rob(const robEntry& entry) {
+    if (!entry.valid)
+        return {};
+    const auto& f_ctrl = entry.f_ctrl;
+    const uint64_t bits = uint64_t{1} | uint64_t{entry.commited.value} << 1 | uint64_t{f_ctrl.trap.value} << 2 |
+                          uint64_t{f_ctrl.recover.value} << 3 | uint64_t{f_ctrl.xret.value} << 4 |
+                          uint64_t{entry.prd_valid.value} << 5 | uint64_t{entry.exu.value} << 8 |
+                          uint64_t{f_ctrl.discon_type.value} << 12 | uint64_t{static_cast<uint16_t>(f_ctrl.cause.value)} << 16 |
+                          uint64_t{entry.prd.value} << 32 | uint64_t{entry.prev_prd.value} << 48;
+    return {entry.pc.value, f_ctrl.recover_pc.value, bits, f_ctrl.xepc.value, f_ctrl.xtval.value};
+}
+
+DpiDeltaTracker::deltaData DpiDeltaTracker::pack_rs(const ReservationStationEntry& entry) {
+    if (!entry.valid)
+        return {};
+    const auto& req = entry.reg_req;
+    const uint64_t bits = uint64_t{1} | uint64_t{entry.pred_taken.value} << 1 | uint64_t{req.prs1_valid.value} << 2 |
+                          uint64_t{req.prs2_valid.value} << 3 | uint64_t{entry.exu.value} << 4 |
+                          uint64_t{entry.params.rob_index.value} << 8 | uint64_t{InstrMixStats::op_key(entry)} << 24 |
+                          uint64_t{req.prs1.value & 0xfffu} << 40 | uint64_t{req.prs2.value & 0xfffu} << 52;
+    return {entry.params.pc.value, entry.pred_pc.value, bits, entry.params.source1.value, entry.params.source2.value};
+}
+
+void DpiDeltaTracker::sample(const DpiManager& dpi, uint64_t cycle, TraceWriter& writer) {
+    traceDelta delta{};
+    delta.cycle = cycle;
+    auto emit = [&](trace_record_t type, size_t index, const deltaData& data) {
+        delta.type = type;
+        delta.index = static_cast<uint16_t>(index);
+        std::ranges::copy(data, delta.data);
+        writer.append(delta);
+    };
+
+    for (size_t i = 0; i < CFG_ROB_SIZE; i++) {
+        auto data = pack_rob(dpi.rob_data[i]);
+        if (data != rob_prev[i]) {
+            rob_prev[i] = data;
+            emit(TRACE_RECORD_ROB, i, data);
+        }
+    }
+    for (size_t i = 0; i < CFG_RS_SIZE; i++) {
+        auto data = pack_rs(dpi.rs_data[i]);
+        if (data != rs_prev[i]) {
+            rs_prev[i] = data;
+            emit(TRACE_RECORD_RS, i, data);
+        }
+    }
+    for (size_t ckpt = 0; ckpt < CFG_RT_SIZE; ckpt++) {
+        const auto& table = dpi.rt_data[ckpt];
+        if (table == rt_prev[ckpt])
+            continue;
+        for (size_t reg = 0; reg < table.size(); reg++) {
+            if (table[reg] != rt_prev[ckpt][reg])
+                emit(TRACE_RECORD_RT, ckpt << 5 | (reg + 1), {table[reg]});
+        }
+        rt_prev[ckpt] = table;
+    }
+    for (size_t i = 0; i < CFG_RF_SIZE; i++) {
+        const auto& reg = dpi.rf_data[i];
+        if (reg.data != rf_prev[i][0] || reg.state != rf_prev[i][1]) {
+            rf_prev[i] = {reg.data, reg.state};
+            emit(TRACE_RECORD_RF, i, rf_prev[i]);
+        }
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+#include "manager.hpp"
+#include "../trace_writer.hpp"
+
+/**
+ * @brief Emits a traceDelta for every ROB/RS/RT/RF entry that changed since the previous cycle.
+ * Entries are compared in their packed trace form, see traceDelta for the layouts.
+ */
+class DpiDeltaTracker {
+public:
+    // Once per cycle after the posedge
+    void sample(const DpiManager& dpi, uint64_t cycle, TraceWriter& writer);
+
+private:
+    using deltaData = std::array<uint64_t, 5>;
+
+    std::array<deltaData, CFG_ROB_SIZE> rob_prev{};
+    std::array<deltaData, CFG_RS_SIZE> rs_prev{};
+    std::array<std::array<uint32_t, 31>, CFG_RT_SIZE> rt_prev{};
+    std::array<deltaData, CFG_RF_SIZE> rf_prev{};
+
+    static deltaData pack_rob(const robEntry& entry);
+    static deltaData pack_rs(const ReservationStationEntry& entry);
+};
@@ -1,5 +1,13 @@
 #include "elf.hpp"
 
+#include <algorithm>
+#include <format>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 template <typename T, typename U>
 U read_data(const uint8_t* data, size_t offset, std::endian endianness) {
     T value;
@@ -153,30 +161,79 @@ std::string ELF::SectionHeader64::get_flags_string() const {
 }
 
 ELF ELF::from_file(const fs::path& file_path) {
-    std::ifstream file(file_path, std::ios::binary);
-    if (!file.is_open()) {
+    int fd = open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
         throw std::runtime_error("Failed to open file: " + file_path.string());
     }
 
-    std::vector<uint8_t> raw_data;
-    char buffer[4096];
-    while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
-        raw_data.insert(raw_data.end(), buffer, buffer + file.gcount());
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error("Failed to stat file: " + file_path.string());
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    if (size == 0) {
+        close(fd);
+        throw std::runtime_error("Incomplete ELF header data");
+    }
+
+    void* base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        throw std::runtime_error("Failed to map file: " + file_path.string());
     }
+    // Segments are copied front to back exactly once
+    madvise(base, size, MADV_SEQUENTIAL);
 
-    return from_raw(raw_data);
+    ELF elf_file;
+    elf_file.storage_ = std::shared_ptr<const void>(base, [size](const void* p) { munmap(const_cast<void*>(p), size); });
+    elf_file.data_ = {static_cast<const uint8_t*>(base), size};
+    elf_file.parse();
+    return elf_file;
 }
 
 ELF ELF::from_raw(const std::vector<uint8_t>& raw_data) {
     ELF elf_file;
-    elf_file.raw_data_ = raw_data;
-    elf_file.parse_header();
-    elf_file.parse_program_headers();
-    elf_file.parse_section_headers();
-    elf_file.load_section_names_string_table();
+    auto buffer = std::make_shared<const std::vector<uint8_t>>(raw_data);
+    elf_file.data_ = *buffer;
+    elf_file.storage_ = std::move(buffer);
+    elf_file.parse();
     return elf_file;
 }
 
+void ELF::parse() {
+    parse_header();
+    parse_program_headers();
+    parse_section_headers();
+    load_section_names_string_table();
+    load_symbols();
+}
+
+std::span<const uint8_t> ELF::get_range(uint64_t offset, uint64_t size) const {
+    if (offset > data_.size() || size > data_.size() - offset) {
+        throw std::runtime_error("ELF range outside file bounds");
+    }
+    return data_.subspan(offset, size);
+}
+
+std::span<const uint8_t> ELF::get_segment_data(const ProgramHeader32& ph) const {
+    return get_range(ph.p_offset, ph.p_filesz);
+}
+
+std::span<const uint8_t> ELF::get_segment_data(const ProgramHeader64& ph) const {
+    return get_range(ph.p_offset, ph.p_filesz);
+}
+
+std::span<const uint8_t> ELF::get_section_data(const SectionHeader32& sh) const {
+    if (sh.sh_type == SectionType::SHT_NOBITS) return {};
+    return get_range(sh.sh_offset, sh.sh_size);
+}
+
+std::span<const uint8_t> ELF::get_section_data(const SectionHeader64& sh) const {
+    if (sh.sh_type == SectionType::SHT_NOBITS) return {};
+    return get_range(sh.sh_offset, sh.sh_size);
+}
+
 const ELF::Header32& ELF::get_header_32() const {
     if (class_type_ != ClassType::ELFCLASS32) {
         throw std::runtime_error("Not a 32-bit ELF file");
@@ -203,28 +260,28 @@ ELF::MachineType ELF::get_machine_type() const {
     }
 }
 
-const std::vector<ELF::ProgramHeader32>& ELF::get_program_headers_32() const {
+std::span<const ELF::ProgramHeader32> ELF::get_program_headers_32() const {
     if (class_type_ != ClassType::ELFCLASS32) {
         throw std::runtime_error("Not a 32-bit ELF file");
     }
     return program_headers_32_;
 }
 
-const std::vector<ELF::ProgramHeader64>& ELF::get_program_headers_64() const {
+std::span<const ELF::ProgramHeader64> ELF::get_program_headers_64() const {
     if (class_type_ != ClassType::ELFCLASS64) {
         throw std::runtime_error("Not a 64-bit ELF file");
     }
     return program_headers_64_;
 }
 
-const std::vector<ELF::SectionHeader32>& ELF::get_section_headers_32() const {
+std::span<const ELF::SectionHeader32> ELF::get_section_headers_32() const {
     if (class_type_ != ClassType::ELFCLASS32) {
         throw std::runtime_error("Not a 32-bit ELF file");
     }
     return section_headers_32_;
 }
 
-const std::vector<ELF::SectionHeader64>& ELF::get_section_headers_64() const {
+std::span<const ELF::SectionHeader64> ELF::get_section_headers_64() const {
     if (class_type_ != ClassType::ELFCLASS64) {
         throw std::runtime_error("Not a 64-bit ELF file");
     }
@@ -392,22 +449,22 @@ void ELF::print_header() const {
 }
 
 void ELF::parse_header() {
-    if (raw_data_.size() < 16) {
+    if (data_.size() < 16) {
         throw std::runtime_error("Incomplete ELF header data");
     }
 
-    if (raw_data_[0] != 0x7F || raw_data_[1] != 'E' || raw_data_[2] != 'L' ||
-        raw_data_[3] != 'F') {
+    if (data_[0] != 0x7F || data_[1] != 'E' || data_[2] != 'L' ||
+        data_[3] != 'F') {
         throw std::runtime_error("Invalid ELF magic number");
     }
 
-    class_type_ = static_cast<ClassType>(raw_data_[4]);
+    class_type_ = static_cast<ClassType>(data_[4]);
     if (class_type_ != ClassType::ELFCLASS64 &&
         class_type_ != ClassType::ELFCLASS32) {
         throw std::runtime_error("Unsupported ELF class");
     }
 
-    data_encoding_ = static_cast<DataEncoding>(raw_data_[5]);
+    data_encoding_ = static_cast<DataEncoding>(data_[5]);
     if (data_encoding_ == DataEncoding::ELFDATA2LSB) {
         target_endian_ = std::endian::little;
     } else if (data_encoding_ == DataEncoding::ELFDATA2MSB) {
@@ -419,66 +476,66 @@ void ELF::parse_header() {
     size_t header_size = (class_type_ == ClassType::ELFCLASS32)
                              ? sizeof(Header32)
                              : sizeof(Header64);
-    if (raw_data_.size() < header_size) {
+    if (data_.size() < header_size) {
         throw std::runtime_error("Incomplete ELF header data");
     }
 
     if (class_type_ == ClassType::ELFCLASS32) {
-        std::memcpy(&header_32_.e_ident, raw_data_.data(), 16);
+        std::memcpy(&header_32_.e_ident, data_.data(), 16);
         header_32_.e_type = read_data<uint16_t, FileType>(
-            raw_data_.data(), offsetof(Header32, e_type), target_endian_);
+            data_.data(), offsetof(Header32, e_type), target_endian_);
         header_32_.e_machine = read_data<uint16_t, MachineType>(
-            raw_data_.data(), offsetof(Header32, e_machine), target_endian_);
+            data_.data(), offsetof(Header32, e_machine), target_endian_);
         header_32_.e_version = read_data<uint32_t>(
-            raw_data_.data(), offsetof(Header32, e_version), target_endian_);
+            data_.data(), offsetof(Header32, e_version), target_endian_);
         header_32_.e_entry = read_data<uint32_t>(
-            raw_data_.data(), offsetof(Header32, e_entry), target_endian_);
+            data_.data(), offsetof(Header32, e_entry), target_endian_);
         header_32_.e_phoff = read_data<uint32_t>(
-            raw_data_.data(), offsetof(Header32, e_phoff), target_endian_);
+            data_.data(), offsetof(Header32, e_phoff), target_endian_);
         header_32_.e_shoff = read_data<uint32_t>(
-            raw_data_.data(), offsetof(Header32, e_shoff), target_endian_);
+            data_.data(), offsetof(Header32, e_shoff), target_endian_);
         header_32_.e_flags = read_data<uint32_t>(
-            raw_data_.data(), offsetof(Header32, e_flags), target_endian_);
+            data_.data(), offsetof(Header32, e_flags), target_endian_);
         header_32_.e_ehsize = read_data<uint16_t>(
-            raw_data_.data(), offsetof(Header32, e_ehsize), target_endian_);
+            data_.data(), offsetof(Header32, e_ehsize), target_endian_);
         header_32_.e_phentsize = read_data<uint16_t>(
-            raw_data_.data(), offsetof(Header32, e_phentsize), target_endian_);
+            data_.data(), offsetof(Header32, e_phentsize), target_endian_);
         header_32_.e_phnum = read_data<uint16_t>(
-            raw_data_.data(), offsetof(Header32, e_phnum), target_endian_);
+            data_.data(), offsetof(Header32, e_phnum), target_endian_);
         header_32_.e_shentsize = read_data<uint16_t>(
-            raw_data_.data(), offsetof(Header32, e_shentsize), target_endian_);
+            data_.data(), offsetof(Header32, e_shentsize), target_endian_);
         header_32_.e_shnum = read_data<uint16_t>(
-            raw_data_.data(), offsetof(Header32, e_shnum), target_endian_);
+            data_.data(), offsetof(Header32, e_shnum), target_endian_);
         header_32_.e_shstrndx = read_data<uint16_t>(
-            raw_data_.data(), offsetof(Header32, e_shstrndx), target_endian_);
+            data_.data(), offsetof(Header32, e_shstrndx), target_endian_);
     } else {
-        std::memcpy(&header_64_.e_ident, raw_data_.data(), 16);
+        std::memcpy(&header_64_.e_ident, data_.data(), 16);
         header_64_.e_type = read_data<uint16_t, FileType>(
-            raw_data_.data(), offsetof(Header64, e_type), target_endian_);
+            data_.data(), offsetof(Header64, e_type), target_endian_);
         header_64_.e_machine = read_data<uint16_t, MachineType>(
-            raw_data_.data(), offsetof(Header64, e_machine), target_endian_);
+            data_.data(), offsetof(Header64, e_machine), target_endian_);
         header_64_.e_version = read_data<uint32_t>(
-            raw_data_.data(), offsetof(Header64, e_version), target_endian_);
+            data_.data(), offsetof(Header64, e_version), target_endian_);
         header_64_.e_entry = read_data<uint64_t>(
-            raw_data_.data(), offsetof(Header64, e_entry), target_endian_);
+            data_.data(), offsetof(Header64, e_entry), target_endian_);
         header_64_.e_phoff = read_data<uint64_t>(
-            raw_data_.data(), offsetof(Header64, e_phoff), target_endian_);
+            data_.data(), offsetof(Header64, e_phoff), target_endian_);
         header_64_.e_shoff = read_data<uint64_t>(
-            raw_data_.data(), offsetof(Header64, e_shoff), target_endian_);
+            data_.data(), offsetof(Header64, e_shoff), target_endian_);
         header_64_.e_flags = read_data<uint32_t>(
-            raw_data_.data(), offsetof(Header64, e_flags), target_endian_);
+            data_.data(), offsetof(Header64, e_flags), target_endian_);
         header_64_.e_ehsize = read_data<uint16_t>(
-            raw_data_.data(), offsetof(Header64, e_ehsize), target_endian_);
+            data_.data(), offsetof(Header64, e_ehsize), target_endian_);
         header_64_.e_phentsize = read_data<uint16_t>(
-            raw_data_.data(), offsetof(Header64, e_phentsize), target_endian_);
+            data_.data(), offsetof(Header64, e_phentsize), target_endian_);
         header_64_.e_phnum = read_data<uint16_t>(
-            raw_data_.data(), offsetof(Header64, e_phnum), target_endian_);
+            data_.data(), offsetof(Header64, e_phnum), target_endian_);
         header_64_.e_shentsize = read_data<uint16_t>(
-            raw_data_.data(), offsetof(Header64, e_shentsize), target_endian_);
+            data_.data(), offsetof(Header64, e_shentsize), target_endian_);
         header_64_.e_shnum = read_data<uint16_t>(
-            raw_data_.data(), offsetof(Header64, e_shnum), target_endian_);
+            data_.data(), offsetof(Header64, e_shnum), target_endian_);
         header_64_.e_shstrndx = read_data<uint16_t>(
-            raw_data_.data(), offsetof(Header64, e_shstrndx), target_endian_);
+            data_.data(), offsetof(Header64, e_shstrndx), target_endian_);
     }
 }
 
@@ -492,26 +549,26 @@ void ELF::parse_program_headers() {
 
         for (uint16_t i = 0; i < ph_num; i++) {
             uint32_t offset = ph_offset + i * ph_entsize;
-            if (offset + ph_entsize > raw_data_.size()) {
+            if (offset + ph_entsize > data_.size()) {
                 throw std::runtime_error("Program header outside file bounds");
             }
 
             ProgramHeader32 ph;
             ph.p_type = read_data<uint32_t, SegmentType>(
-                raw_data_.data(), offset, target_endian_);
-            ph.p_offset = read_data<uint32_t>(raw_data_.data(), offset + 4,
+                data_.data(), offset, target_endian_);
+            ph.p_offset = read_data<uint32_t>(data_.data(), offset + 4,
                                               target_endian_);
-            ph.p_vaddr = read_data<uint32_t>(raw_data_.data(), offset + 8,
+            ph.p_vaddr = read_data<uint32_t>(data_.data(), offset + 8,
                                              target_endian_);
-            ph.p_paddr = read_data<uint32_t>(raw_data_.data(), offset + 12,
+            ph.p_paddr = read_data<uint32_t>(data_.data(), offset + 12,
                                              target_endian_);
-            ph.p_filesz = read_data<uint32_t>(raw_data_.data(), offset + 16,
+            ph.p_filesz = read_data<uint32_t>(data_.data(), offset + 16,
                                               target_endian_);
-            ph.p_memsz = read_data<uint32_t>(raw_data_.data(), offset + 20,
+            ph.p_memsz = read_data<uint32_t>(data_.data(), offset + 20,
                                              target_endian_);
-            ph.p_flags = read_data<uint32_t>(raw_data_.data(), offset + 24,
+            ph.p_flags = read_data<uint32_t>(data_.data(), offset + 24,
                                              target_endian_);
-            ph.p_align = read_data<uint32_t>(raw_data_.data(), offset + 28,
+            ph.p_align = read_data<uint32_t>(data_.data(), offset + 28,
                                              target_endian_);
 
             program_headers_32_.push_back(ph);
@@ -525,26 +582,26 @@ void ELF::parse_program_headers() {
 
         for (uint16_t i = 0; i < ph_num; i++) {
             uint64_t offset = ph_offset + i * ph_entsize;
-            if (offset + ph_entsize > raw_data_.size()) {
+            if (offset + ph_entsize > data_.size()) {
                 throw std::runtime_error("Program header outside file bounds");
             }
 
             ProgramHeader64 ph;
             ph.p_type = read_data<uint32_t, SegmentType>(
-                raw_data_.data(), offset, target_endian_);
-            ph.p_flags = read_data<uint32_t>(raw_data_.data(), offset + 4,
+                data_.data(), offset, target_endian_);
+            ph.p_flags = read_data<uint32_t>(data_.data(), offset + 4,
                                              target_endian_);
-            ph.p_offset = read_data<uint64_t>(raw_data_.data(), offset + 8,
+            ph.p_offset = read_data<uint64_t>(data_.data(), offset + 8,
                                               target_endian_);
-            ph.p_vaddr = read_data<uint64_t>(raw_data_.data(), offset + 16,
+            ph.p_vaddr = read_data<uint64_t>(data_.data(), offset + 16,
                                              target_endian_);
-            ph.p_paddr = read_data<uint64_t>(raw_data_.data(), offset + 24,
+            ph.p_paddr = read_data<uint64_t>(data_.data(), offset + 24,
                                              target_endian_);
-            ph.p_filesz = read_data<uint64_t>(raw_data_.data(), offset + 32,
+            ph.p_filesz = read_data<uint64_t>(data_.data(), offset + 32,
                                               target_endian_);
-            ph.p_memsz = read_data<uint64_t>(raw_data_.data(), offset + 40,
+            ph.p_memsz = read_data<uint64_t>(data_.data(), offset + 40,
                                              target_endian_);
-            ph.p_align = read_data<uint64_t>(raw_data_.data(), offset + 48,
+            ph.p_align = read_data<uint64_t>(data_.data(), offset + 48,
                                              target_endian_);
 
             program_headers_64_.push_back(ph);
@@ -562,30 +619,30 @@ void ELF::parse_section_headers() {
 
         for (uint16_t i = 0; i < sh_num; i++) {
             uint32_t offset = sh_offset + i * sh_entsize;
-            if (offset + sh_entsize > raw_data_.size()) {
+            if (offset + sh_entsize > data_.size()) {
                 throw std::runtime_error("Section header outside file bounds");
             }
 
             SectionHeader32 sh;
             sh.sh_name =
-                read_data<uint32_t>(raw_data_.data(), offset, target_endian_);
+                read_data<uint32_t>(data_.data(), offset, target_endian_);
             sh.sh_type = read_data<uint32_t, SectionType>(
-                raw_data_.data(), offset + 4, target_endian_);
-            sh.sh_flags = read_data<uint32_t>(raw_data_.data(), offset + 8,
+                data_.data(), offset + 4, target_endian_);
+            sh.sh_flags = read_data<uint32_t>(data_.data(), offset + 8,
                                               target_endian_);
-            sh.sh_addr = read_data<uint32_t>(raw_data_.data(), offset + 12,
+            sh.sh_addr = read_data<uint32_t>(data_.data(), offset + 12,
                                              target_endian_);
-            sh.sh_offset = read_data<uint32_t>(raw_data_.data(), offset + 16,
+            sh.sh_offset = read_data<uint32_t>(data_.data(), offset + 16,
                                                target_endian_);
-            sh.sh_size = read_data<uint32_t>(raw_data_.data(), offset + 20,
+            sh.sh_size = read_data<uint32_t>(data_.data(), offset + 20,
                                              target_endian_);
-            sh.sh_link = read_data<uint32_t>(raw_data_.data(), offset + 24,
+            sh.sh_link = read_data<uint32_t>(data_.data(), offset + 24,
                                              target_endian_);
-            sh.sh_info = read_data<uint32_t>(raw_data_.data(), offset + 28,
+            sh.sh_info = read_data<uint32_t>(data_.data(), offset + 28,
                                              target_endian_);
-            sh.sh_addralign = read_data<uint32_t>(raw_data_.data(), offset + 32,
+            sh.sh_addralign = read_data<uint32_t>(data_.data(), offset + 32,
                                                   target_endian_);
-            sh.sh_entsize = read_data<uint32_t>(raw_data_.data(), offset + 36,
+            sh.sh_entsize = read_data<uint32_t>(data_.data(), offset + 36,
                                                 target_endian_);
 
             section_headers_32_.push_back(sh);
@@ -599,30 +656,30 @@ void ELF::parse_section_headers() {
 
         for (uint16_t i = 0; i < sh_num; i++) {
             uint64_t offset = sh_offset + i * sh_entsize;
-            if (offset + sh_entsize > raw_data_.size()) {
+            if (offset + sh_entsize > data_.size()) {
                 throw std::runtime_error("Section header outside file bounds");
             }
 
             SectionHeader64 sh;
             sh.sh_name =
-                read_data<uint32_t>(raw_data_.data(), offset, target_endian_);
+                read_data<uint32_t>(data_.data(), offset, target_endian_);
             sh.sh_type = read_data<uint32_t, SectionType>(
-                raw_data_.data(), offset + 4, target_endian_);
-            sh.sh_flags = read_data<uint64_t>(raw_data_.data(), offset + 8,
+                data_.data(), offset + 4, target_endian_);
+            sh.sh_flags = read_data<uint64_t>(data_.data(), offset + 8,
                                               target_endian_);
-            sh.sh_addr = read_data<uint64_t>(raw_data_.data(), offset + 16,
+            sh.sh_addr = read_data<uint64_t>(data_.data(), offset + 16,
                                              target_endian_);
-            sh.sh_offset = read_data<uint64_t>(raw_data_.data(), offset + 24,
+            sh.sh_offset = read_data<uint64_t>(data_.data(), offset + 24,
                                                target_endian_);
-            sh.sh_size = read_data<uint64_t>(raw_data_.data(), offset + 32,
+            sh.sh_size = read_data<uint64_t>(data_.data(), offset + 32,
                                              target_endian_);
-            sh.sh_link = read_data<uint32_t>(raw_data_.data(), offset + 40,
+            sh.sh_link = read_data<uint32_t>(data_.data(), offset + 40,
                                              target_endian_);
-            sh.sh_info = read_data<uint32_t>(raw_data_.data(), offset + 44,
+            sh.sh_info = read_data<uint32_t>(data_.data(), offset + 44,
                                              target_endian_);
-            sh.sh_addralign = read_data<uint64_t>(raw_data_.data(), offset + 48,
+            sh.sh_addralign = read_data<uint64_t>(data_.data(), offset + 48,
                                                   target_endian_);
-            sh.sh_entsize = read_data<uint64_t>(raw_data_.data(), offset + 56,
+            sh.sh_entsize = read_data<uint64_t>(data_.data(), offset + 56,
                                                 target_endian_);
 
             section_headers_64_.push_back(sh);
@@ -659,13 +716,12 @@ void ELF::load_section_names_string_table() {
         sh_size = section_headers_64_[shstrndx].sh_size;
     }
 
-    if (sh_offset + sh_size > raw_data_.size()) {
+    if (sh_offset > data_.size() || sh_size > data_.size() - sh_offset) {
         return;  // String table out of bounds
     }
 
-    section_names_string_table_.resize(sh_size);
-    std::memcpy(section_names_string_table_.data(),
-                raw_data_.data() + sh_offset, sh_size);
+    section_names_string_table_ = {
+        reinterpret_cast<const char*>(data_.data()) + sh_offset, sh_size};
 }
 
 std::string ELF::get_section_name(const SectionHeader32& sh) const {
@@ -678,7 +734,9 @@ std::string ELF::get_section_name(const SectionHeader32& sh) const {
     if (section_names_string_table_[sh.sh_name] == 0) {
         return "[empty name]";
     }
-    return &section_names_string_table_[sh.sh_name];
+    // The mapping isn't guaranteed to be NUL terminated past the table
+    auto name = section_names_string_table_.subspan(sh.sh_name);
+    return std::string(name.begin(), std::ranges::find(name, '\0'));
 }
 
 std::string ELF::get_section_name(const SectionHeader64& sh) const {
@@ -691,5 +749,109 @@ std::string ELF::get_section_name(const SectionHeader64& sh) const {
     if (section_names_string_table_[sh.sh_name] == 0) {
         return "[empty name]";
     }
-    return &section_names_string_table_[sh.sh_name];
+    // The mapping isn't guaranteed to be NUL terminated past the table
+    auto name = section_names_string_table_.subspan(sh.sh_name);
+    return std::string(name.begin(), std::ranges::find(name, '\0'));
+}
+
+
+std::optional<ELF::SectionHeader32> ELF::find_section_32(const std::string& name) const {
+    for (const auto& sh : get_section_headers_32()) {
+        if (get_section_name(sh) == name) return sh;
+    }
+    return std::nullopt;
+}
+
+std::optional<ELF::SectionHeader64> ELF::find_section_64(const std::string& name) const {
+    for (const auto& sh : get_section_headers_64()) {
+        if (get_section_name(sh) == name) return sh;
+    }
+    return std::nullopt;
+}
+
+void ELF::load_symbols() {
+    // Both classes are walked through 64-bit section headers, 32-bit entries are widened
+    std::vector<SectionHeader64> sections;
+    if (class_type_ == ClassType::ELFCLASS32) {
+        for (const auto& sh : section_headers_32_) {
+            sections.push_back({sh.sh_name, sh.sh_type, sh.sh_flags, sh.sh_addr, sh.sh_offset,
+                                sh.sh_size, sh.sh_link, sh.sh_info, sh.sh_addralign, sh.sh_entsize});
+        }
+    } else {
+        sections = section_headers_64_;
+    }
+    const bool is_32 = class_type_ == ClassType::ELFCLASS32;
+    const uint64_t entry_size = is_32 ? 16 : 24;
+
+    for (const auto& symtab : sections) {
+        if (symtab.sh_type != SectionType::SHT_SYMTAB || symtab.sh_link >= sections.size())
+            continue;
+        const auto& strtab = sections[symtab.sh_link];
+        if (strtab.sh_offset > data_.size() || strtab.sh_size > data_.size() - strtab.sh_offset ||
+            symtab.sh_offset > data_.size() || symtab.sh_size > data_.size() - symtab.sh_offset)
+            throw std::runtime_error("Symbol table outside file bounds");
+        std::string_view strings(reinterpret_cast<const char*>(data_.data()) + strtab.sh_offset, strtab.sh_size);
+
+        // Entry 0 is the reserved null symbol
+        for (uint64_t offset = symtab.sh_offset + entry_size; offset + entry_size <= symtab.sh_offset + symtab.sh_size;
+             offset += entry_size) {
+            const uint8_t* entry = data_.data() + offset;
+            uint32_t name = read_data<uint32_t>(entry, 0, target_endian_);
+            uint8_t info = is_32 ? entry[12] : entry[4];
+            Symbol sym;
+            sym.addr = is_32 ? read_data<uint32_t>(entry, 4, target_endian_) : read_data<uint64_t>(entry, 8, target_endian_);
+            sym.size = is_32 ? read_data<uint32_t>(entry, 8, target_endian_) : read_data<uint64_t>(entry, 16, target_endian_);
+            sym.shndx = read_data<uint16_t>(entry, is_32 ? 14 : 6, target_endian_);
+            sym.type = static_cast<SymbolType>(info & 0xf);
+            sym.binding = static_cast<SymbolBinding>(info >> 4);
+
+            if (sym.shndx == SHN_UNDEF || sym.type == SymbolType::STT_SECTION || sym.type == SymbolType::STT_FILE)
+                continue;
+            if (name >= strings.size())
+                continue;
+            sym.name = strings.substr(name, strings.find('\0', name) - name);
+            // Mapping symbols ($x, $d) mark code/data, they aren't names
+            if (sym.name.empty() || sym.name.front() == '$')
+                continue;
+            symbols_.push_back(sym);
+        }
+    }
+
+    // Of symbols sharing an address the last one wins a lookup, so functions and globals go last
+    auto rank = [](const Symbol& sym) {
+        return std::tuple(sym.addr, sym.type == SymbolType::STT_FUNC, sym.binding != SymbolBinding::STB_LOCAL, sym.size);
+    };
+    std::ranges::stable_sort(symbols_, {}, rank);
+}
+
+const ELF::Symbol* ELF::find_symbol(uint64_t addr) const {
+    auto it = std::ranges::upper_bound(symbols_, addr, {}, &Symbol::addr);
+    if (it == symbols_.begin())
+        return nullptr;
+    const Symbol& sym = *std::prev(it);
+    if (sym.size && addr - sym.addr >= sym.size)
+        return nullptr;
+    return &sym;
+}
+
+std::optional<uint64_t> ELF::find_symbol_addr(std::string_view name) const {
+    const Symbol* found = nullptr;
+    for (const auto& sym : symbols_) {
+        if (sym.name != name)
+            continue;
+        if (sym.binding != SymbolBinding::STB_LOCAL)
+            return sym.addr;
+        if (!found)
+            found = &sym;
+    }
+    if (found)
+        return found->addr;
+    return std::nullopt;
+}
+
+std::string ELF::symbolize(uint64_t addr) const {
+    const Symbol* sym = find_symbol(addr);
+    if (!sym)
+        return "";
+    return std::format("{}+0x{:x}", sym->name, addr - sym->addr);
 }
@@ -5,9 +5,13 @@
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <span>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace fs = std::filesystem;
@@ -349,6 +353,40 @@ class ELF {
 
     static std::string section_flags_to_string(uint64_t flags);
 
+    /**
+     * @brief Symbol type (low nibble of st_info).
+     */
+    enum class SymbolType : uint8_t {
+        STT_NOTYPE = 0,   // Symbol type is unspecified
+        STT_OBJECT = 1,   // Symbol is a data object
+        STT_FUNC = 2,     // Symbol is a code object
+        STT_SECTION = 3,  // Symbol associated with a section
+        STT_FILE = 4,     // Symbol's name is file name
+        STT_COMMON = 5,   // Symbol is a common data object
+        STT_TLS = 6       // Symbol is thread-local data object
+    };
+
+    /**
+     * @brief Symbol binding (high nibble of st_info).
+     */
+    enum class SymbolBinding : uint8_t {
+        STB_LOCAL = 0,   // Local symbol
+        STB_GLOBAL = 1,  // Global symbol
+        STB_WEAK = 2     // Weak symbol
+    };
+
+    /**
+     * @brief Decoded .symtab entry, the name is a view into the string table.
+     */
+    struct Symbol {
+        std::string_view name;
+        uint64_t addr;
+        uint64_t size;
+        SymbolType type;
+        SymbolBinding binding;
+        uint16_t shndx;
+    };
+
     /**
      * @brief 32-bit ELF header structure.
      */
@@ -464,6 +502,7 @@ class ELF {
     ELF() = default;
     ~ELF() = default;
 
+    // Maps the file read-only, headers are decoded once and contents are served as views into the mapping
     static ELF from_file(const fs::path& file_path);
     static ELF from_raw(const std::vector<uint8_t>& raw_data);
 
@@ -473,11 +512,18 @@ class ELF {
     ClassType get_class_type() const;
     MachineType get_machine_type() const;
 
-    const std::vector<ProgramHeader32>& get_program_headers_32() const;
-    const std::vector<ProgramHeader64>& get_program_headers_64() const;
+    std::span<const ProgramHeader32> get_program_headers_32() const;
+    std::span<const ProgramHeader64> get_program_headers_64() const;
 
-    const std::vector<SectionHeader32>& get_section_headers_32() const;
-    const std::vector<SectionHeader64>& get_section_headers_64() const;
+    std::span<const SectionHeader32> get_section_headers_32() const;
+    std::span<const SectionHeader64> get_section_headers_64() const;
+
+    // Views stay valid for as long as any copy of this ELF is alive
+    std::span<const uint8_t> get_data() const { return data_; }
+    std::span<const uint8_t> get_segment_data(const ProgramHeader32& ph) const;
+    std::span<const uint8_t> get_segment_data(const ProgramHeader64& ph) const;
+    std::span<const uint8_t> get_section_data(const SectionHeader32& sh) const;
+    std::span<const uint8_t> get_section_data(const SectionHeader64& sh) const;
 
     void print_program_header(const ProgramHeader32& ph) const;
     void print_program_header(const ProgramHeader64& ph) const;
@@ -492,8 +538,20 @@ class ELF {
     std::string get_section_name(const SectionHeader32& sh) const;
     std::string get_section_name(const SectionHeader64& sh) const;
 
+    std::optional<SectionHeader32> find_section_32(const std::string& name) const;
+    std::optional<SectionHeader64> find_section_64(const std::string& name) const;
+
+    // Defined code and data symbols sorted by address
+    std::span<const Symbol> get_symbols() const { return symbols_; }
+    // Symbol covering addr, sizeless labels cover up to the next symbol
+    const Symbol* find_symbol(uint64_t addr) const;
+    std::optional<uint64_t> find_symbol_addr(std::string_view name) const;
+    // "func+0x10" for addresses covered by a symbol, empty otherwise
+    std::string symbolize(uint64_t addr) const;
+
    private:
-    std::vector<uint8_t> raw_data_;
+    std::shared_ptr<const void> storage_;  // Owns the mapping or the copied buffer
+    std::span<const uint8_t> data_;
     Header64 header_64_;
     Header32 header_32_;
     std::vector<ProgramHeader32> program_headers_32_;
@@ -503,10 +561,14 @@ class ELF {
     ClassType class_type_;
     DataEncoding data_encoding_;
     std::endian target_endian_;
-    std::vector<char> section_names_string_table_;
+    std::span<const char> section_names_string_table_;
+    std::vector<Symbol> symbols_;
 
+    std::span<const uint8_t> get_range(uint64_t offset, uint64_t size) const;
+    void parse();
     void parse_header();
     void parse_program_headers();
     void parse_section_headers();
     void load_section_names_string_table();
+    void load_symbols();
 };
@@ -1,20 +1,73 @@
+#include <map>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <cerrno>
+#include <csignal>
+#include <thread>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef MARKORV_CAPSTONE
 #include <capstone/capstone.h>
-#include <verilated_vcd_c.h>
+constexpr bool DISASM_CAPSTONE = true;
+#else
+constexpr bool DISASM_CAPSTONE = false;
+#endif
 
 #include "VMarkoRvCore.h"
 #include "config.hpp"
 #include "elf.hpp"
+#include "disasm.hpp"
 #include "arg_parser.hpp"
+#include "checkpoint.hpp"
+#include "profiler.hpp"
+#include "waveform.hpp"
+#include "guest_profiler.hpp"
+#include "flight_recorder.hpp"
+#include "trace_writer.hpp"
 #include "axi_signal.hpp"
 #include "axi_bus.hpp"
+#include "mem_timing.hpp"
 #include "slaves/slave.hpp"
 #include "slaves/clint.hpp"
 #include "slaves/plic.hpp"
 #include "slaves/virtual_ram.hpp"
 #include "slaves/virtual_uart.hpp"
 #include "dpi/manager.hpp"
+#include "dpi/instr_mix.hpp"
+#include "dpi/occupancy.hpp"
+#include "dpi/rob_tracker.hpp"
+#include "dpi/trace_deltas.hpp"
+
+enum sim_exit_t { SIM_EXIT_OK = 0, SIM_EXIT_ERROR = 1, SIM_EXIT_TOHOST_FAIL = 2, SIM_EXIT_TIMEOUT = 3, SIM_EXIT_INTERRUPTED = 4 };
+
+// Set by SIGINT/SIGTERM, the running simulation stops at the next cycle and dumps its flight recorder
+volatile std::sig_atomic_t sim_interrupted = 0;
 
-csh capstone_handle;
+void on_interrupt(int) {
+    sim_interrupted = 1;
+}
+
+// Host time accounting of the simulation loop for --stats
+enum sim_phase_t { PHASE_DEBUG, PHASE_EVAL_POSEDGE, PHASE_EVAL_NEGEDGE, PHASE_TRACE, PHASE_READ_AXI, PHASE_SLAVES, PHASE_SET_AXI, PHASE_NUM };
+constexpr const char* sim_phase_names[PHASE_NUM] = {
+    "debug", "eval_posedge", "eval_negedge", "trace", "read_axi", "sim_step", "set_axi"
+};
+
+struct SimulationResult {
+    int exit_code = SIM_EXIT_OK;
+    uint64_t cycles = 0;
+    std::optional<uint64_t> tohost;
+    uint64_t idle_skipped = 0;
+    std::vector<std::string> mem_timing;
+    std::optional<uint64_t> stop_pc;
+    std::string stop_symbol;
+    std::optional<flight_reason_t> flight_reason;
+    uint64_t flight_cycle = 0;
+    std::string flight_file;
+    std::vector<std::pair<uint64_t, std::optional<uint64_t>>> results;
+};
 
 void read_axi(const std::unique_ptr<VMarkoRvCore> &top, axiSignal &axi) {
     // Write request signals (Master->Slave)
@@ -132,30 +185,35 @@ void axi_debug(const axiSignal& axi) {
                              axi.rvalid, axi.rready, axi.rdata, axi.rresp);
 }
 
-void cycle_verbose(uint64_t cycle, uint64_t pc, std::optional<uint32_t> raw_instr) {
-    uint8_t raw_code[4] = {0};
-    std::cout << std::format("Cycle: 0x{:04x} PC: 0x{:016x} Instr: 0x{:08x} Asm: ",cycle, pc, raw_instr.value_or(0));
-
-    if (!raw_instr) {
-        std::cout << "null" << std::endl;
-        return;
-    }
+void cycle_verbose(const std::string& disasm, uint64_t cycle, uint64_t pc, const std::string& symbol, std::optional<uint32_t> raw_instr) {
+    std::cout << std::format("Cycle: 0x{:04x} PC: 0x{:016x} {}Instr: 0x{:08x} Asm: {}\n", cycle, pc,
+                             symbol.empty() ? "" : "<" + symbol + "> ", raw_instr.value_or(0),
+                             raw_instr ? std::string_view(disasm) : "null");
+}
 
+#ifdef MARKORV_CAPSTONE
+// Reference disassembly of --capstone builds to cross-check the built-in tables
+std::string capstone_disasm(csh capstone_handle, uint64_t pc, uint32_t raw_instr) {
+    uint8_t raw_code[4] = {0};
     for(int i=0;i<4;i++) {
-        raw_code[i] = static_cast<uint8_t>(raw_instr.value() >> 8*i);
+        raw_code[i] = static_cast<uint8_t>(raw_instr >> 8*i);
     }
 
     cs_insn *instr;
-    uint64_t count;
-    count = cs_disasm(capstone_handle, raw_code, 4, pc, 0, &instr);
-	if (count > 0) {
-		for (int i = 0;i<count;i++) {
-			std::cout << instr[i].mnemonic << " " << instr[i].op_str << std::endl;
-		}
-		cs_free(instr, count);
-	} else {
-		std::cout << "invalid" << std::endl;
-    }
+    size_t count = cs_disasm(capstone_handle, raw_code, 4, pc, 1, &instr);
+    if (count == 0)
+        return "invalid";
+    std::string text = std::format("{} {}", instr[0].mnemonic, instr[0].op_str);
+    cs_free(instr, count);
+    return text;
+}
+#endif
+
+std::vector<uint8_t> read_file(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        throw std::runtime_error("Can't open file: " + path);
+    return std::vector<uint8_t>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
 }
 
 void init_stimulus(const std::unique_ptr<VMarkoRvCore> &top) {
@@ -166,41 +224,259 @@ void init_stimulus(const std::unique_ptr<VMarkoRvCore> &top) {
 
 class SimulationManager {
 public:
-    SimulationManager(parsedArgs& args) {
+    SimulationManager(const parsedArgs& args) {
+        clint_id = slaves.register_slave(std::make_shared<VirtualCLINT> (0x02000000));
+        plic_id  =  slaves.register_slave(std::make_shared<VirtualPLIC> (0x0C000000));
+        rom_id   =  slaves.register_slave(std::make_shared<VirtualRAM>  (0x01000000, CFG_ROM_SIZE));
+        ram_id   =  slaves.register_slave(std::make_shared<VirtualRAM>  (args.ram_base, args.ram_size, args.ram_huge_pages, args.ram_file));
+        uart_id  =  slaves.register_slave(std::make_shared<VirtualUart> (0x10000000, 0x0a, !args.server && !args.fork_at));
+        std::dynamic_pointer_cast<VirtualUart>(slaves.get_slave(uart_id))->set_interrupt_controller(std::dynamic_pointer_cast<VirtualPLIC>(slaves.get_slave(plic_id)));
+    }
+
+    ~SimulationManager() {
+        finalize_top();
+#ifdef MARKORV_CAPSTONE
+        if (capstone_open)
+            cs_close(&capstone_handle);
+#endif
+    }
+
+    // Bring up a fresh model and put every slave back to power-on state with the job payloads loaded
+    void reset(const parsedArgs& args) {
+        finalize_top();
         context = std::make_unique<VerilatedContext>();
-        top = std::make_unique<VMarkoRvCore>();
-        if (args.vcd_dump.has_value()) {
-            vcd_context = std::make_unique<VerilatedVcdC>();
-            Verilated::traceEverOn(true);
-            top->trace(vcd_context.get(), 0);
-            vcd_context->open(args.vcd_dump.value().c_str());
+        top = std::make_unique<VMarkoRvCore>(context.get());
+        if (args.wave_dump.has_value()) {
+            if (args.wave_fst != WAVEFORM_FST)
+                throw std::runtime_error(WAVEFORM_FST ? "This simulator is built for FST tracing, use --fst-dump"
+                                                      : "This simulator is built for VCD tracing, rebuild with TRACE_FST=1 for --fst-dump");
+            waveformConfig config;
+            config.path = *args.wave_dump;
+            config.scopes = args.trace_scopes;
+            config.window_start = args.trace_start;
+            config.window_end = args.trace_end;
+            config.triggered = !args.trace_triggers.empty() || args.trace_mmio.has_value();
+            config.trigger_length = args.trace_length;
+            tracer = std::make_unique<WaveformTracer>(config, context.get(), top.get());
         }
+        if (args.capstone && !DISASM_CAPSTONE)
+            throw std::runtime_error("This simulator is built without Capstone, rebuild with CAPSTONE=1 for --capstone");
+#ifdef MARKORV_CAPSTONE
+        // Only opened when asked for, the built-in disassembler serves --verbose otherwise
+        if (args.capstone && !capstone_open) {
+            if (cs_open(CS_ARCH_RISCV, CS_MODE_RISCV64, &capstone_handle) != CS_ERR_OK)
+                throw std::runtime_error("Capstone engine failed to init.");
+            capstone_open = true;
+        }
+#endif
         top->clock = 0;
         top->reset = 0;
-        clint_id = slaves.register_slave(std::make_shared<VirtualCLINT> (0x02000000));
-        plic_id  =  slaves.register_slave(std::make_shared<VirtualPLIC> (0x0C000000));
-        rom_id   =  slaves.register_slave(std::make_shared<VirtualRAM>  (0x01000000, args.rom_path, CFG_ROM_SIZE));
-        ram_id   =  slaves.register_slave(std::make_shared<VirtualRAM>  (0x80000000, args.ram_path, CFG_RAM_SIZE));
-        uart_id  =  slaves.register_slave(std::make_shared<VirtualUart> (0x10000000, 0x0a));
-        std::dynamic_pointer_cast<VirtualUart>(slaves.get_slave(uart_id))->set_interrupt_controller(std::dynamic_pointer_cast<VirtualPLIC>(slaves.get_slave(plic_id)));
 
-        if (cs_open(CS_ARCH_RISCV, CS_MODE_RISCV64, &capstone_handle) != CS_ERR_OK) {
-            throw std::runtime_error("Capstone engine failed to init.");
+        slaves.reset();
+        slaves.configure(args.axi_outstanding, args.axi_out_of_order);
+        slaves.set_timing(args.mem_timing ? default_mem_timing() : std::vector<memTimingConfig>{});
+        std::dynamic_pointer_cast<VirtualRAM>(slaves.get_slave(rom_id))->load(args.rom_path);
+        std::dynamic_pointer_cast<VirtualRAM>(slaves.get_slave(ram_id))->load(args.ram_path);
+        rom_elf = ELF::from_file(args.rom_path);
+        ram_elf = ELF::from_file(args.ram_path);
+
+        // riscv-tests style payloads report their result through .tohost
+        tohost_addr = std::nullopt;
+        tohost_value = std::nullopt;
+        if (auto tohost = ram_elf.find_section_64(".tohost"))
+            tohost_addr = tohost->sh_addr;
+        else
+            tohost_addr = ram_elf.find_symbol_addr("tohost");
+        if (tohost_addr) {
+            slaves.add_write_watch(*tohost_addr, [this](uint64_t data) {
+                if (data != 0)
+                    tohost_value = data;
+            });
+        }
+
+        stop_pcs.clear();
+        for (const auto& stop : args.stop_at) {
+            stop_pcs.push_back(resolve_symbol(stop));
         }
+        trace_trigger_pcs.clear();
+        for (const auto& trigger : args.trace_triggers) {
+            trace_trigger_pcs.push_back(resolve_symbol(trigger));
+        }
+        trap_vector_pcs.clear();
+        for (const auto& vector : args.trap_vectors) {
+            trap_vector_pcs.push_back(resolve_symbol(vector));
+        }
+        trace_mmio_hit = false;
+        if (args.trace_mmio)
+            slaves.add_write_watch(*args.trace_mmio, [this](uint64_t) { trace_mmio_hit = true; });
+
+        start_cycle = 0;
+        dcache_clean = {};
+        irq_schedule.clear();
+        irq_schedule_ptr = 0;
+        if (args.restore_checkpoint.has_value())
+            restore_checkpoint(args.restore_checkpoint.value());
     }
 
-    ~SimulationManager() {
-        top->final(); // Ensure top is finalized before destruction
+    // Memory overlays, UART input and interrupt schedule of a run, applied at the current cycle
+    void apply_variant(const parsedArgs& args) {
+        for (const auto& overlay : args.overlays) {
+            load_overlay(overlay);
+        }
+        if (args.uart_input.has_value()) {
+            std::dynamic_pointer_cast<VirtualUart>(slaves.get_slave(uart_id))->push_input(read_file(args.uart_input.value()));
+        }
+        if (args.uart_out.has_value()) {
+            std::dynamic_pointer_cast<VirtualUart>(slaves.get_slave(uart_id))->set_output(args.uart_out.value());
+        }
+        irq_schedule = args.irq_injections;
+        irq_schedule_ptr = 0;
+    }
+
+    // Model, bus and slave state at the top of a cycle, RAM included
+    void save_checkpoint(const std::string& path, uint64_t cycle) {
+        VerilatedSave os;
+        os.open(path.c_str());
+        if (!os.isOpen())
+            throw std::runtime_error("Can't create checkpoint file: " + path);
+
+        save_pod(os, CHECKPOINT_MAGIC);
+        save_pod(os, static_cast<uint64_t>(CHECKPOINT_VERSION));
+        save_pod(os, cycle);
+        os << *top;
+        slaves.save_state(os);
+        save_pod(os, dcache_clean);
+        os.close();
     }
 
-    void run_simulation(parsedArgs args) {
-        uint64_t clock_cnt = 0;
+    void restore_checkpoint(const std::string& path) {
+        VerilatedRestore is;
+        is.open(path.c_str());
+        if (!is.isOpen())
+            throw std::runtime_error("Can't open checkpoint file: " + path);
+
+        uint64_t magic = 0;
+        uint64_t version = 0;
+        restore_pod(is, magic);
+        restore_pod(is, version);
+        if (magic != CHECKPOINT_MAGIC || version != CHECKPOINT_VERSION)
+            throw std::runtime_error("Not a compatible checkpoint file: " + path);
+        restore_pod(is, start_cycle);
+        is >> *top;
+        slaves.restore_state(is);
+        restore_pod(is, dcache_clean);
+        is.close();
+    }
+
+    // RAM payload symbols shadow the boot ROM ones
+    const ELF::Symbol* find_symbol(uint64_t addr) const {
+        const ELF::Symbol* symbol = ram_elf.find_symbol(addr);
+        return symbol ? symbol : rom_elf.find_symbol(addr);
+    }
+
+    std::string symbolize(uint64_t addr) const {
+        std::string symbol = ram_elf.symbolize(addr);
+        return symbol.empty() ? rom_elf.symbolize(addr) : symbol;
+    }
+
+    // A symbol of either payload, or a hex address
+    uint64_t resolve_symbol(const std::string& name) const {
+        if (auto addr = ram_elf.find_symbol_addr(name))
+            return *addr;
+        if (auto addr = rom_elf.find_symbol_addr(name))
+            return *addr;
+        size_t used = 0;
+        try {
+            uint64_t addr = std::stoull(name, &used, 16);
+            if (used == name.size())
+                return addr;
+        } catch (...) {
+        }
+        throw std::runtime_error("Unknown symbol: " + name);
+    }
+
+    // Instruction word at addr of the ROM or RAM, without going through the bus
+    std::optional<uint32_t> read_instr(uint64_t addr) {
+        for (const auto id : {rom_id, ram_id}) {
+            auto mem = std::dynamic_pointer_cast<VirtualRAM>(slaves.get_slave(id));
+            if (addr >= mem->base_addr && addr - mem->base_addr + 4 <= mem->size) {
+                uint32_t instr;
+                std::memcpy(&instr, mem->ram + (addr - mem->base_addr), sizeof(instr));
+                return instr;
+            }
+        }
+        return std::nullopt;
+    }
+
+    // A trap landing outside the --trap-vector handlers, or outside ROM and RAM when none are given
+    bool unexpected_trap_vector(uint64_t pc) {
+        if (!trap_vector_pcs.empty())
+            return std::ranges::find(trap_vector_pcs, pc) == trap_vector_pcs.end();
+        for (const auto id : {rom_id, ram_id}) {
+            auto mem = std::dynamic_pointer_cast<VirtualRAM>(slaves.get_slave(id));
+            if (pc >= mem->base_addr && pc - mem->base_addr < mem->size)
+                return false;
+        }
+        return true;
+    }
+
+    SimulationResult run_simulation(const parsedArgs& args) {
+        uint64_t clock_cnt = start_cycle;
         axiSignal axi;
-        DpiManager& dpi = DpiManager::get_instance();
+        DpiManager::Binding dpi_binding(dpi);
+        dpi.set_symbolizer([this](uint64_t addr) { return symbolize(addr); });
+
+        profiler = args.stats ? std::make_unique<HostProfiler>() : nullptr;
+        std::array<size_t, PHASE_NUM> phase_counters{};
+        if (profiler) {
+            for (size_t i = 0; i < PHASE_NUM; i++) {
+                phase_counters[i] = profiler->add_counter("phases", sim_phase_names[i]);
+            }
+        }
+        slaves.set_profiler(profiler.get());
+        dpi.set_profiler(profiler.get());
+        if (profiler)
+            profiler->begin();
+        uint64_t first_cycle = clock_cnt;
+
+        std::unique_ptr<GuestProfiler> guest_profiler;
+        if (args.guest_profile)
+            guest_profiler = std::make_unique<GuestProfiler>([this](uint64_t addr) { return find_symbol(addr); },
+                                                             [this](uint64_t addr) { return read_instr(addr); }, args.guest_profile_interval);
+        auto instr_mix = args.instr_mix ? std::make_unique<InstrMixStats>(dpi) : nullptr;
+        auto occupancy = args.occupancy ? std::make_unique<OccupancyStats>(*args.occupancy, args.occupancy_interval, dpi) : nullptr;
+
+        auto flight = args.flight_depth && args.flight_file ? std::make_unique<FlightRecorder>(args.flight_depth) : nullptr;
+        RobRetireTracker record_retire(dpi);
+        std::optional<flight_reason_t> flight_reason;
+        uint64_t flight_cycle = 0;
+        auto flight_dump = [&](flight_reason_t reason) {
+            // Only the first failure of a run is kept, later ones are usually its fallout
+            if (!flight || flight_reason)
+                return;
+            flight_reason = reason;
+            flight_cycle = clock_cnt;
+            flight->dump(*args.flight_file, reason, clock_cnt);
+        };
+        uint64_t traps_seen = dpi.trap_count;
+
+        auto exec_trace = args.exec_trace ? std::make_unique<TraceWriter>(*args.exec_trace, args.exec_trace_mmap) : nullptr;
+        DpiDeltaTracker exec_deltas;
+        const bool recording = flight || exec_trace;
+        traceRecord record{};
 
         uint64_t cleanup_dcache_at = args.max_clock - args.cleanup_dcache_addrs.size() * DCACHE_CLEANUP_TIME_PER_ADDR;
-        uint64_t cleanup_dcache_ptr = 0;
-        while (!Verilated::gotFinish() && clock_cnt < args.max_clock) {
+        uint64_t& cleanup_dcache_ptr = dcache_clean.cleanup_ptr;
+        bool& tohost_clean_pending = dcache_clean.tohost_pending;
+        bool& cleaning_tohost = dcache_clean.cleaning_tohost;
+        bool idle_tohost_cleaned = false;
+        uint64_t idle_skipped = 0;
+        std::optional<uint64_t> stop_pc;
+        while (!context->gotFinish() && clock_cnt < args.max_clock && !tohost_value && !sim_interrupted) {
+            if (args.save_checkpoint == clock_cnt) {
+                save_checkpoint(args.checkpoint_file, clock_cnt);
+            }
+
             // Reset handling
             if (clock_cnt < 4) {
                 top->reset = 1;
@@ -208,91 +484,635 @@ public:
                 top->reset = 0;
             }
 
+            if (!top->reset && !stop_pcs.empty() && std::ranges::find(stop_pcs, dpi.curr_pc) != stop_pcs.end()) {
+                stop_pc = dpi.curr_pc;
+                break;
+            }
+            if (guest_profiler && !top->reset)
+                guest_profiler->tick(clock_cnt, dpi.curr_pc);
+            if (tracer && !top->reset &&
+                (trace_mmio_hit || std::ranges::find(trace_trigger_pcs, dpi.curr_pc) != trace_trigger_pcs.end()))
+                tracer->trigger(clock_cnt);
+            trace_mmio_hit = false;
+
+            // Cycle events go to the flight recorder and the exec trace, failures are dumped once the cycle is complete
+            std::optional<flight_reason_t> cycle_failure;
+            if (recording) {
+                record = {};
+                record.cycle = clock_cnt;
+                record.type = TRACE_RECORD_CYCLE;
+                record.fetch_pc = dpi.curr_pc;
+                if (dpi.fetching_instr) {
+                    record.flags |= TRACE_FETCH;
+                    record.instr = *dpi.fetching_instr;
+                }
+                if (dpi.wfi_waiting)
+                    record.flags |= TRACE_WFI;
+                if (top->reset)
+                    record.flags |= TRACE_RESET;
+            }
+
             // Debug output
-            if (args.verbose) {
-                auto pc = dpi.curr_pc;
-                auto raw_instr = dpi.fetching_instr;
-                cycle_verbose(clock_cnt, pc, raw_instr);
+            const bool debug_window = clock_cnt >= args.debug_start.value_or(0) && clock_cnt < args.debug_end.value_or(UINT64_MAX) &&
+                                      dpi.curr_pc >= args.debug_pc_start.value_or(0) && dpi.curr_pc < args.debug_pc_end.value_or(UINT64_MAX);
+            {
+                HostProfiler::Scope scope(profiler.get(), phase_counters[PHASE_DEBUG]);
+                if (args.verbose) {
+                    auto pc = dpi.curr_pc;
+                    auto raw_instr = dpi.fetching_instr;
+                    std::string disasm;
+#ifdef MARKORV_CAPSTONE
+                    if (args.capstone && raw_instr)
+                        disasm = capstone_disasm(capstone_handle, pc, *raw_instr);
+#endif
+                    cycle_verbose(disasm.empty() && raw_instr ? disasm_cache.get(pc, *raw_instr) : disasm,
+                                  clock_cnt, pc, symbolize(pc), raw_instr);
+                }
+                if (debug_window) {
+                    const bool delta = !args.debug_full;
+                    if (args.rob_debug)
+                        dpi.print_rob(clock_cnt, delta);
+                    if (args.rs_debug)
+                        dpi.print_rs(clock_cnt, delta);
+                    if (args.rt_debug)
+                        dpi.print_rt(clock_cnt, delta);
+                    if (args.rf_debug)
+                        dpi.print_rf(clock_cnt, delta);
+                }
             }
-            if (args.rob_debug)
-                dpi.print_rob();
-            if (args.rs_debug)
-                dpi.print_rs();
-            if (args.rt_debug)
-                dpi.print_rt();
-            if (args.rf_debug)
-                dpi.print_rf();
+
+            // Sample the dcache clean handshake before the posedge consumes it
+            bool clean_fire = top->io_dcacheCleanReq_valid && top->io_dcacheCleanReq_ready;
 
             // Posedge and Negedge clock simulation
             context->timeInc(1);
             top->clock = 1;
-            top->eval();
-            if (args.vcd_dump.has_value())
-                vcd_context->dump(clock_cnt * 2);
+            {
+                HostProfiler::Scope scope(profiler.get(), phase_counters[PHASE_EVAL_POSEDGE]);
+                top->eval();
+            }
+            if (instr_mix && !top->reset)
+                instr_mix->sample(dpi);
+            if (occupancy && !top->reset)
+                occupancy->sample(dpi, clock_cnt);
+            if (recording && !top->reset) {
+                if (auto slot = record_retire.step(dpi)) {
+                    record.flags |= TRACE_RETIRE;
+                    record.retire_pc = slot->pc;
+                    if (slot->trap) {
+                        record.flags |= TRACE_TRAP;
+                        record.cause = slot->cause;
+                    }
+                    if (slot->recover)
+                        record.flags |= TRACE_REDIRECT;
+                    if (slot->xret)
+                        record.flags |= TRACE_XRET;
+                }
+                // Traps and interrupts alike, the exception unit reports the handler it redirects fetch to
+                if (dpi.trap_count != traps_seen) {
+                    traps_seen = dpi.trap_count;
+                    if (dpi.last_trap.interrupt) {
+                        record.flags |= TRACE_INTERRUPT;
+                        record.cause = dpi.last_trap.cause;
+                    }
+                    if (unexpected_trap_vector(dpi.last_trap.vector))
+                        cycle_failure = FLIGHT_TRAP_VECTOR;
+                }
+                if (exec_trace)
+                    exec_deltas.sample(dpi, clock_cnt, *exec_trace);
+            }
+            if (tracer) {
+                HostProfiler::Scope scope(profiler.get(), phase_counters[PHASE_TRACE]);
+                tracer->dump(clock_cnt, clock_cnt * 2);
+            }
             init_stimulus(top);
-            if (top->io_dcacheCleanReq_valid) {
-                cleanup_dcache_ptr++;
+            if (clean_fire) {
+                if (cleaning_tohost)
+                    tohost_clean_pending = false;
+                else
+                    cleanup_dcache_ptr++;
             }
+            // The tohost store sits in the write-back dcache, clean it periodically so the bus can see it
+            if (tohost_addr && clock_cnt % CFG_TOHOST_CLEAN_INTERVAL == 0) {
+                tohost_clean_pending = true;
+            }
+            cleaning_tohost = false;
             if (clock_cnt > cleanup_dcache_at && cleanup_dcache_ptr < args.cleanup_dcache_addrs.size()) {
                 top->io_dcacheCleanReq_valid = true;
                 top->io_dcacheCleanReq_bits_addr = args.cleanup_dcache_addrs[cleanup_dcache_ptr];
+            } else if (tohost_clean_pending && !top->reset) {
+                top->io_dcacheCleanReq_valid = true;
+                top->io_dcacheCleanReq_bits_addr = *tohost_addr;
+                cleaning_tohost = true;
+            }
+
+            while (irq_schedule_ptr < irq_schedule.size() && irq_schedule[irq_schedule_ptr].cycle <= clock_cnt) {
+                const auto& inject = irq_schedule[irq_schedule_ptr++];
+                std::dynamic_pointer_cast<VirtualPLIC>(slaves.get_slave(plic_id))->set_interrupt_level(inject.source, inject.level);
             }
 
             if (!top->reset) {
-                std::memset(&axi, 0, sizeof(axiSignal));
-                read_axi(top, axi);
-                slaves.sim_step(top, axi);
-                if (args.axi_debug)
+                {
+                    HostProfiler::Scope scope(profiler.get(), phase_counters[PHASE_READ_AXI]);
+                    std::memset(&axi, 0, sizeof(axiSignal));
+                    read_axi(top, axi);
+                }
+                {
+                    HostProfiler::Scope scope(profiler.get(), phase_counters[PHASE_SLAVES]);
+                    slaves.sim_step(top, axi);
+                }
+                if (recording) {
+                    if (axi.arvalid && axi.arready) {
+                        record.axi |= TRACE_AXI_AR;
+                        record.ar_addr = axi.araddr;
+                    }
+                    if (axi.awvalid && axi.awready) {
+                        record.axi |= TRACE_AXI_AW;
+                        record.aw_addr = axi.awaddr;
+                    }
+                    if (axi.wvalid && axi.wready)
+                        record.axi |= TRACE_AXI_W;
+                    if (axi.rvalid && axi.rready) {
+                        record.axi |= TRACE_AXI_R | (axi.rlast ? TRACE_AXI_RLAST : 0);
+                        if (axi.rresp >= VirtualAxiSlaves::RESP_SLVERR)
+                            record.axi |= TRACE_AXI_RERR;
+                    }
+                    if (axi.bvalid && axi.bready) {
+                        record.axi |= TRACE_AXI_B;
+                        if (axi.bresp >= VirtualAxiSlaves::RESP_SLVERR)
+                            record.axi |= TRACE_AXI_BERR;
+                    }
+                    if ((axi.rvalid && axi.rready && axi.rresp == VirtualAxiSlaves::RESP_DECERR) ||
+                        (axi.bvalid && axi.bready && axi.bresp == VirtualAxiSlaves::RESP_DECERR))
+                        cycle_failure = FLIGHT_DECERR;
+                }
+                if (args.axi_debug && debug_window) {
+                    HostProfiler::Scope scope(profiler.get(), phase_counters[PHASE_DEBUG]);
                     axi_debug(axi);
-                set_axi(top, axi);
+                }
+                {
+                    HostProfiler::Scope scope(profiler.get(), phase_counters[PHASE_SET_AXI]);
+                    set_axi(top, axi);
+                }
             }
 
             context->timeInc(1);
             top->clock = 0;
-            top->eval();
-            if (args.vcd_dump.has_value())
-                vcd_context->dump(clock_cnt * 2 + 1);
+            {
+                HostProfiler::Scope scope(profiler.get(), phase_counters[PHASE_EVAL_NEGEDGE]);
+                top->eval();
+            }
+            if (tracer) {
+                HostProfiler::Scope scope(profiler.get(), phase_counters[PHASE_TRACE]);
+                tracer->dump(clock_cnt, clock_cnt * 2 + 1);
+            }
+
+            if (recording) {
+                if (flight)
+                    flight->push(record);
+                if (exec_trace)
+                    exec_trace->append(record);
+                if (cycle_failure)
+                    flight_dump(*cycle_failure);
+            }
 
             clock_cnt++;
+
+            // Fast-forward while the core sleeps in wfi and nothing is in flight
+            // wfi_waiting is sampled at the posedge, an interrupt raised since then wakes the core next cycle
+            if (!args.idle_skip || !dpi.wfi_waiting) {
+                idle_tohost_cleaned = false;
+            } else if (!top->reset && slaves.is_idle() && !top->io_dcacheCleanReq_valid && !tohost_clean_pending &&
+                       !top->io_axi_ar_valid && !top->io_axi_aw_valid && !top->io_axi_w_valid &&
+                       !top->io_mtip && !top->io_meip && !top->io_msip) {
+                if (tohost_addr && !idle_tohost_cleaned) {
+                    // Flush a tohost store made before the wfi once, the periodic clean can't run while skipping
+                    tohost_clean_pending = true;
+                    idle_tohost_cleaned = true;
+                    continue;
+                }
+
+                uint64_t skip = args.max_clock - std::min(clock_cnt, args.max_clock);
+                auto bound = [&](uint64_t event_cycle) {
+                    if (event_cycle >= clock_cnt)
+                        skip = std::min(skip, event_cycle - clock_cnt);
+                };
+                if (auto slave_cycles = slaves.idle_cycles())
+                    skip = std::min(skip, *slave_cycles);
+                if (irq_schedule_ptr < irq_schedule.size())
+                    bound(irq_schedule[irq_schedule_ptr].cycle);
+                if (args.save_checkpoint)
+                    bound(*args.save_checkpoint);
+                if (cleanup_dcache_ptr < args.cleanup_dcache_addrs.size())
+                    bound(cleanup_dcache_at + 1);
+                if (auto edge = tracer ? tracer->next_edge(clock_cnt) : std::nullopt)
+                    bound(*edge);
+
+                if (skip > 0) {
+                    if (guest_profiler)
+                        guest_profiler->tick(clock_cnt, dpi.curr_pc, skip);
+                    if (occupancy)
+                        occupancy->sample(dpi, clock_cnt, skip);
+                    slaves.skip_cycles(skip);
+                    context->timeInc(skip * 2);
+                    clock_cnt += skip;
+                    idle_skipped += skip;
+                }
+            }
         }
 
-        if (args.vcd_dump.has_value()) {
-            vcd_context->close();
+        if (sim_interrupted)
+            flight_dump(FLIGHT_SIGNAL);
+        else if (clock_cnt >= args.max_clock && !tohost_value && !stop_pc)
+            flight_dump(FLIGHT_TIMEOUT);
+
+        if (profiler) {
+            profiler->end(clock_cnt - first_cycle);
+            profiler->write_json(*args.stats);
         }
+        if (guest_profiler)
+            guest_profiler->write(*args.guest_profile);
+        if (instr_mix)
+            instr_mix->write_json(*args.instr_mix);
+        if (occupancy)
+            occupancy->finish();
 
+        if (tracer) {
+            tracer->close();
+        }
+        if (exec_trace)
+            exec_trace->close();
+
+        auto ram = std::dynamic_pointer_cast<VirtualRAM>(slaves.get_slave(ram_id));
         if (args.ram_dump.has_value()) {
-            save_ram_dump(args.ram_dump.value());
+            std::vector<std::pair<uint64_t, uint64_t>> ranges;
+            for (const auto& range : args.ram_dump_ranges) {
+                ranges.emplace_back(range.addr, range.len);
+            }
+            ram->dump(args.ram_dump.value(), ranges, args.ram_dump_sparse);
         }
+        // A file-backed RAM is its own dump
+        ram->sync();
+
+        std::dynamic_pointer_cast<VirtualUart>(slaves.get_slave(uart_id))->flush_tx();
+
+        // A later call resumes from here
+        start_cycle = clock_cnt;
+
+        SimulationResult result;
+        result.cycles = clock_cnt;
+        result.tohost = tohost_value;
+        result.idle_skipped = idle_skipped;
+        result.stop_pc = stop_pc;
+        if (stop_pc)
+            result.stop_symbol = symbolize(*stop_pc);
+        result.flight_reason = flight_reason;
+        result.flight_cycle = flight_cycle;
+        if (flight_reason)
+            result.flight_file = *args.flight_file;
+        for (const auto& model : slaves.get_timing()) {
+            result.mem_timing.push_back(model.report());
+        }
+        for (const auto addr : args.result_addrs) {
+            result.results.emplace_back(addr, slaves.peek(addr, 3));
+        }
+
+        if (sim_interrupted)
+            result.exit_code = SIM_EXIT_INTERRUPTED;
+        else if (!tohost_addr)
+            result.exit_code = SIM_EXIT_OK;
+        else if (!tohost_value)
+            result.exit_code = stop_pc ? SIM_EXIT_OK : SIM_EXIT_TIMEOUT;
+        else if (*tohost_value == 1)
+            result.exit_code = SIM_EXIT_OK;
+        else
+            result.exit_code = SIM_EXIT_TOHOST_FAIL;
+        return result;
     }
 
 private:
     std::unique_ptr<VerilatedContext> context;
-    std::unique_ptr<VerilatedVcdC> vcd_context;
+    std::unique_ptr<WaveformTracer> tracer;
     std::unique_ptr<VMarkoRvCore> top;
     VirtualAxiSlaves slaves;
+    DpiManager dpi;
+    std::unique_ptr<HostProfiler> profiler;
+    DisasmCache disasm_cache;
+#ifdef MARKORV_CAPSTONE
+    csh capstone_handle = 0;
+    bool capstone_open = false;
+#endif
+    ELF rom_elf;
+    ELF ram_elf;
+    std::vector<uint64_t> stop_pcs;
+    std::vector<uint64_t> trace_trigger_pcs;
+    std::vector<uint64_t> trap_vector_pcs;
+    bool trace_mmio_hit = false;
     uint64_t clint_id;
     uint64_t plic_id;
     uint64_t rom_id;
     uint64_t ram_id;
     uint64_t uart_id;
+    std::optional<uint64_t> tohost_addr;
+    std::optional<uint64_t> tohost_value;
+    uint64_t start_cycle = 0;
+    // The dcache clean request driven into the model outlives a run_simulation call, and so does its bookkeeping
+    struct dcacheCleanState {
+        uint64_t cleanup_ptr = 0;      // Next --cleanup-dcache address
+        bool tohost_pending = false;   // A tohost clean is due
+        bool cleaning_tohost = false;  // The request on the port is the tohost clean
+    } dcache_clean;
+    std::vector<irqInjection> irq_schedule;
+    size_t irq_schedule_ptr = 0;
 
-    void save_ram_dump(const std::string& dump_path) {
-        std::ofstream dump_file(dump_path, std::ios::out | std::ios::binary);
-        if (!dump_file) {
-            std::cerr << "Can't create dump file.\n";
+    void load_overlay(const memOverlay& overlay) {
+        auto data = read_file(overlay.path);
+        for (const auto id : {rom_id, ram_id}) {
+            auto mem = std::dynamic_pointer_cast<VirtualRAM>(slaves.get_slave(id));
+            if (overlay.addr < mem->base_addr || overlay.addr - mem->base_addr >= mem->size)
+                continue;
+            uint64_t offset = overlay.addr - mem->base_addr;
+            if (data.size() > mem->size - offset)
+                throw std::runtime_error(std::format("Overlay size({:x}) exceeds available memory space", data.size()));
+            std::memcpy(mem->ram + offset, data.data(), data.size());
             return;
         }
+        throw std::runtime_error(std::format("Overlay address({:x}) is not backed by memory", overlay.addr));
+    }
 
-        auto ram = std::dynamic_pointer_cast<VirtualRAM>(slaves.get_slave(ram_id));
-        if (!ram) {
-            std::cerr << "Can't dump ram.\n";
+    void finalize_top() {
+        if (top)
+            top->final(); // Ensure top is finalized before destruction
+        tracer.reset();
+        top.reset();
+    }
+};
+
+std::string result_to_text(const SimulationResult& result, const std::string& prefix = "") {
+    std::string text;
+    if (result.exit_code == SIM_EXIT_INTERRUPTED) {
+        text += std::format("{}interrupted: 0x{:x} cycles\n", prefix, result.cycles);
+    } else if (result.exit_code == SIM_EXIT_TIMEOUT) {
+        text += std::format("{}tohost timeout: no result after 0x{:x} cycles\n", prefix, result.cycles);
+    } else if (result.exit_code == SIM_EXIT_TOHOST_FAIL) {
+        text += std::format("{}tohost fail: {}\n", prefix, *result.tohost >> 1);
+    } else if (result.tohost) {
+        text += std::format("{}tohost pass: 0x{:x} cycles\n", prefix, result.cycles);
+    }
+    if (result.stop_pc) {
+        text += std::format("{}stopped at 0x{:016x}{}: 0x{:x} cycles\n", prefix, *result.stop_pc,
+                            result.stop_symbol.empty() ? "" : " <" + result.stop_symbol + ">", result.cycles);
+    }
+    if (result.flight_reason) {
+        text += std::format("{}flight recorder: {} at 0x{:x}, dumped to {}\n", prefix,
+                            flight_reason_names[*result.flight_reason], result.flight_cycle, result.flight_file);
+    }
+    for (const auto& line : result.mem_timing) {
+        text += std::format("{}{}\n", prefix, line);
+    }
+    if (result.idle_skipped) {
+        text += std::format("{}idle skipped: 0x{:x} cycles\n", prefix, result.idle_skipped);
+    }
+    for (const auto& [addr, value] : result.results) {
+        if (value)
+            text += std::format("{}result 0x{:016x}: 0x{:016x}\n", prefix, addr, *value);
+        else
+            text += std::format("{}result 0x{:016x}: unmapped\n", prefix, addr);
+    }
+    return text;
+}
+
+std::string result_to_json(uint64_t job_id, const SimulationResult& result) {
+    std::string results;
+    for (const auto& [addr, value] : result.results) {
+        if (!results.empty())
+            results += ",";
+        results += value ? std::format("\"0x{:x}\":{}", addr, *value) : std::format("\"0x{:x}\":null", addr);
+    }
+    std::string stop = "null";
+    if (result.stop_pc)
+        stop = std::format("{{\"pc\":{},\"symbol\":\"{}\"}}", *result.stop_pc, result.stop_symbol);
+    std::string flight = "null";
+    if (result.flight_reason)
+        flight = std::format("{{\"reason\":\"{}\",\"cycle\":{},\"file\":\"{}\"}}",
+                             flight_reason_names[*result.flight_reason], result.flight_cycle, result.flight_file);
+    return std::format("{{\"job\":{},\"exit\":{},\"cycles\":{},\"tohost\":{},\"stop\":{},\"flight\":{},\"results\":{{{}}}}}",
+                       job_id, result.exit_code, result.cycles,
+                       result.tohost ? std::to_string(*result.tohost) : "null", stop, flight, results);
+}
+
+std::string error_to_json(uint64_t job_id, const std::string& error) {
+    std::string escaped;
+    for (const char ch : error) {
+        if (ch == '"' || ch == '\\')
+            escaped += '\\';
+        escaped += ch;
+    }
+    return std::format("{{\"job\":{},\"exit\":{},\"error\":\"{}\"}}", job_id, static_cast<int>(SIM_EXIT_ERROR), escaped);
+}
+
+// One simulator process serving many jobs, each line on stdin holds the options of one run.
+// Every worker thread owns a whole simulation instance, results are printed as jobs finish.
+int run_server(const parsedArgs& server_args) {
+    std::mutex queue_lock;
+    std::mutex output_lock;
+    std::condition_variable queue_cv;
+    std::deque<std::pair<uint64_t, parsedArgs>> jobs;
+    bool input_closed = false;
+
+    auto print_line = [&](const std::string& line) {
+        std::lock_guard lock(output_lock);
+        std::cout << line << std::endl;
+    };
+
+    auto worker = [&]() {
+        try {
+            SimulationManager sim_manager(server_args);
+            while (true) {
+                std::unique_lock lock(queue_lock);
+                queue_cv.wait(lock, [&]() { return !jobs.empty() || input_closed; });
+                if (jobs.empty())
+                    return;
+                auto [job_id, job_args] = std::move(jobs.front());
+                jobs.pop_front();
+                lock.unlock();
+                if (job_args.flight_file)
+                    *job_args.flight_file += std::format(".{}", job_id);
+                if (job_args.exec_trace)
+                    *job_args.exec_trace += std::format(".{}", job_id);
+
+                try {
+                    sim_manager.reset(job_args);
+                    sim_manager.apply_variant(job_args);
+                    print_line(result_to_json(job_id, sim_manager.run_simulation(job_args)));
+                } catch (const std::exception& e) {
+                    print_line(error_to_json(job_id, e.what()));
+                }
+            }
+        } catch (const std::exception& e) {
+            std::lock_guard lock(output_lock);
+            std::cerr << "Server worker error: " << e.what() << "\n";
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (uint64_t i = 0; i < std::max<uint64_t>(server_args.server_threads, 1); i++) {
+        workers.emplace_back(worker);
+    }
+
+    std::string line;
+    uint64_t job_id = 0;
+    while (std::getline(std::cin, line)) {
+        std::vector<std::string> tokens = {"job"};
+        std::istringstream stream(line);
+        for (std::string token; stream >> token;) {
+            tokens.push_back(token);
+        }
+        if (tokens.size() == 1)
+            continue;
+
+        // The guest RAM is built once per worker from the server options, a job can't change it.
+        // --help would print the usage into the JSON stream on stdout.
+        auto instance_option = std::find_if(tokens.begin() + 1, tokens.end(), [](const std::string& token) {
+            const auto name = token.substr(0, token.find('='));
+            return name == "--ram-base" || name == "--ram-size" || name == "--ram-file" || name == "--ram-thp" ||
+                   name == "--help";
+        });
+        if (instance_option != tokens.end()) {
+            print_line(error_to_json(job_id++, instance_option->substr(0, instance_option->find('=')) +
+                                                   " only applies to the --server command line"));
+            continue;
+        }
+
+        std::vector<char*> job_argv;
+        for (auto& token : tokens) {
+            job_argv.push_back(token.data());
+        }
+
+        parsedArgs job_args;
+        if (parse_args(job_argv.size(), job_argv.data(), job_args) != 0 || job_args.server || job_args.fork_at) {
+            print_line(error_to_json(job_id++, "invalid job options"));
+            continue;
+        }
+
+        {
+            std::lock_guard lock(queue_lock);
+            jobs.emplace_back(job_id++, std::move(job_args));
+        }
+        queue_cv.notify_one();
+    }
+
+    {
+        std::lock_guard lock(queue_lock);
+        input_closed = true;
+    }
+    queue_cv.notify_all();
+    for (auto& thread : workers) {
+        thread.join();
+    }
+
+    return SIM_EXIT_OK;
+}
+
+// Simulate the shared prefix once, then fork() one copy-on-write child per variant
+int run_fork(SimulationManager& sim_manager, const parsedArgs& args) {
+    if (args.wave_dump.has_value())
+        throw std::runtime_error("Waveform dumps can't be combined with --fork-at");
+    if (*args.fork_at >= args.max_clock)
+        throw std::runtime_error("--fork-at must be below --max-clock");
+
+    std::ifstream variants_file(*args.fork_variants);
+    if (!variants_file)
+        throw std::runtime_error("Can't open variants file: " + *args.fork_variants);
+    std::vector<parsedArgs> variants;
+    for (std::string line; std::getline(variants_file, line);) {
+        if (line.find_first_not_of(" \t") == std::string::npos || line.front() == '#')
+            continue;
+        parsedArgs variant;
+        if (parse_variant(line, args, variant) != 0)
+            return SIM_EXIT_ERROR;
+        variants.push_back(std::move(variant));
+    }
+    if (variants.empty())
+        throw std::runtime_error("No variants in " + *args.fork_variants);
+
+    parsedArgs prefix_args = args;
+    prefix_args.max_clock = *args.fork_at;
+    prefix_args.cleanup_dcache_addrs.clear();
+    prefix_args.ram_dump.reset();
+    prefix_args.result_addrs.clear();
+    // The prefix runs to --fork-at on purpose, each variant records its own flight
+    prefix_args.flight_depth = 0;
+    prefix_args.exec_trace.reset();
+    sim_manager.apply_variant(args);
+    auto prefix = sim_manager.run_simulation(prefix_args);
+    if (prefix.tohost || prefix.stop_pc || prefix.exit_code == SIM_EXIT_INTERRUPTED) {
+        std::cout << "Finished before the fork point\n" << result_to_text(prefix);
+        return prefix.exit_code;
+    }
+
+    const uint64_t max_jobs = args.fork_jobs ? args.fork_jobs : std::max(1u, std::thread::hardware_concurrency());
+    std::map<pid_t, size_t> running;
+    std::vector<int> exit_codes(variants.size(), SIM_EXIT_ERROR);
+    auto reap = [&]() {
+        int status = 0;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            // No children left to wait for, keep the remaining variants marked as errors
+            if (errno != EINTR)
+                running.clear();
+            return;
+        }
+        auto it = running.find(pid);
+        if (it == running.end())
             return;
+        exit_codes[it->second] = WIFEXITED(status) ? WEXITSTATUS(status) : SIM_EXIT_ERROR;
+        running.erase(it);
+    };
+
+    for (size_t i = 0; i < variants.size(); i++) {
+        while (running.size() >= max_jobs) {
+            reap();
         }
 
-        dump_file.write(reinterpret_cast<const char*>(ram->ram), ram->size);
-        dump_file.close();
+        // Nothing buffered may be inherited, the child would print it again
+        std::cout.flush();
+        std::cerr.flush();
+        pid_t pid = fork();
+        if (pid < 0)
+            throw std::runtime_error("fork() failed");
+
+        if (pid == 0) {
+            int code = SIM_EXIT_ERROR;
+            try {
+                if (variants[i].flight_file)
+                    *variants[i].flight_file += std::format(".{}", i);
+                if (variants[i].exec_trace)
+                    *variants[i].exec_trace += std::format(".{}", i);
+                sim_manager.apply_variant(variants[i]);
+                auto result = sim_manager.run_simulation(variants[i]);
+                std::cout << result_to_text(result, std::format("[variant {}] ", i)) << std::flush;
+                code = result.exit_code;
+            } catch (const std::exception& e) {
+                std::cerr << std::format("[variant {}] Error: {}\n", i, e.what()) << std::flush;
+            }
+            // Skip destructors, the parent still owns the model and the terminal
+            _exit(code);
+        }
+        running[pid] = i;
+    }
+    while (!running.empty()) {
+        reap();
     }
-};
+
+    int exit_code = SIM_EXIT_OK;
+    for (size_t i = 0; i < variants.size(); i++) {
+        std::cout << std::format("[variant {}] exit {}\n", i, exit_codes[i]);
+        if (exit_code == SIM_EXIT_OK)
+            exit_code = exit_codes[i];
+    }
+    return exit_code;
+}
 
 int main(int argc, char **argv, char **env)
 {
@@ -303,12 +1123,26 @@ int main(int argc, char **argv, char **env)
         return 1;
 
     try {
+        if (args.server)
+            return run_server(args);
+
+        std::signal(SIGINT, on_interrupt);
+        std::signal(SIGTERM, on_interrupt);
+
+        std::cout << std::format("ROM payload path: {}\n", args.rom_path);
+        std::cout << std::format("RAM payload path: {}\n", args.ram_path);
+
         SimulationManager sim_manager(args);
-        sim_manager.run_simulation(args);
+        sim_manager.reset(args);
+        if (args.fork_at.has_value())
+            return run_fork(sim_manager, args);
+
+        sim_manager.apply_variant(args);
+        auto result = sim_manager.run_simulation(args);
+        std::cout << result_to_text(result);
+        return result.exit_code;
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << "\n";
-        return 1;
+        return SIM_EXIT_ERROR;
     }
-
-    return 0;
 }
@@ -0,0 +1,31 @@
+#include "flight_recorder.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <fstream>
+#include <stdexcept>
+
+FlightRecorder::FlightRecorder(uint64_t depth)
+    : ring(std::bit_ceil(std::max<uint64_t>(depth, 1))), mask(ring.size() - 1) {}
+
+void FlightRecorder::dump(const std::string& path, flight_reason_t reason, uint64_t trigger_cycle) const {
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        throw std::runtime_error("Can't open flight recorder file: " + path);
+
+    traceHeader header;
+    header.record_size = sizeof(traceRecord);
+    header.kind = TRACE_KIND_FLIGHT;
+    header.reason = reason;
+    header.trigger_cycle = trigger_cycle;
+    header.records = std::min<uint64_t>(recorded, ring.size());
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    // The oldest record sits at the write position once the ring has wrapped
+    const uint64_t first = recorded - header.records;
+    for (uint64_t i = 0; i < header.records; i++) {
+        file.write(reinterpret_cast<const char*>(&ring[(first + i) & mask]), sizeof(traceRecord));
+    }
+    if (!file)
+        throw std::runtime_error("Can't write flight recorder file: " + path);
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "trace_format.hpp"
+
+/**
+ * @brief Ring of the last cycles of a run, written as a flight trace when something goes wrong.
+ * Recording a cycle is one record copy, so it can stay enabled for whole runs given a --flight-file.
+ */
+class FlightRecorder {
+public:
+    // depth is rounded up to a power of two
+    explicit FlightRecorder(uint64_t depth);
+
+    void push(const traceRecord& record) { ring[recorded++ & mask] = record; }
+    // Header and the held records oldest first
+    void dump(const std::string& path, flight_reason_t reason, uint64_t trigger_cycle) const;
+
+private:
+    std::vector<traceRecord> ring;
+    uint64_t mask;
+    uint64_t recorded = 0;
+};
@@ -0,0 +1,116 @@
+#include "guest_profiler.hpp"
+
+#include <algorithm>
+#include <format>
+#include <fstream>
+#include <stdexcept>
+
+GuestProfiler::GuestProfiler(SymbolLookup lookup, InstrLookup fetch, uint64_t interval)
+    : lookup(std::move(lookup)), fetch(std::move(fetch)), interval(std::max<uint64_t>(interval, 1)) {}
+
+void GuestProfiler::tick(uint64_t cycle, uint64_t pc, uint64_t cycles) {
+    if (pc != last_pc) {
+        enter(pc);
+        last_pc = pc;
+    }
+
+    // Samples fall on the cycles that are multiples of the interval
+    const uint64_t count = (cycle + cycles + interval - 1) / interval - (cycle + interval - 1) / interval;
+    if (count == 0)
+        return;
+    samples += count;
+    pc_samples[pc] += count;
+    node_samples[stack.back()] += count;
+}
+
+void GuestProfiler::enter(uint64_t pc) {
+    if (current && current->size && pc - current->addr < current->size)
+        return;
+    const ELF::Symbol* symbol = lookup(pc);
+    if (!stack.empty() && symbol == current)
+        return;
+    current = symbol;
+
+    if (stack.empty()) {
+        stack.push_back(child(0, symbol));
+        return;
+    }
+    // Call: the first instruction of a function
+    if (symbol && pc == symbol->addr && stack.size() < MAX_DEPTH) {
+        stack.push_back(child(stack.back(), symbol));
+        return;
+    }
+    // Return: back into a caller
+    for (size_t i = stack.size(); i-- > 0;) {
+        if (nodes[stack[i]].symbol == symbol) {
+            stack.resize(i + 1);
+            return;
+        }
+    }
+    // Jump, tail call or trap: replaces the innermost frame
+    stack.back() = child(nodes[stack.back()].parent, symbol);
+}
+
+uint32_t GuestProfiler::child(uint32_t parent, const ELF::Symbol* symbol) {
+    auto [it, inserted] = children.try_emplace({parent, symbol}, static_cast<uint32_t>(nodes.size()));
+    if (inserted) {
+        nodes.push_back({parent, symbol});
+        node_samples.push_back(0);
+    }
+    return it->second;
+}
+
+std::string GuestProfiler::symbol_name(const ELF::Symbol* symbol) {
+    return symbol ? std::string(symbol->name) : "[unknown]";
+}
+
+void GuestProfiler::write(const std::string& path) const {
+    std::ofstream flat(path);
+    if (!flat)
+        throw std::runtime_error("Can't open guest profile file: " + path);
+    auto percent = [this](uint64_t count) { return samples ? 100.0 * count / samples : 0.0; };
+
+    std::map<const ELF::Symbol*, uint64_t> function_samples;
+    for (const auto& [pc, count] : pc_samples) {
+        function_samples[lookup(pc)] += count;
+    }
+    std::vector<std::pair<const ELF::Symbol*, uint64_t>> functions(function_samples.begin(), function_samples.end());
+    std::ranges::sort(functions, std::greater{}, &std::pair<const ELF::Symbol*, uint64_t>::second);
+
+    flat << std::format("# {} samples, one every {} cycles\n", samples, interval);
+    flat << std::format("# {:>7} {:>12}  {}\n", "self%", "samples", "function");
+    for (const auto& [symbol, count] : functions) {
+        flat << std::format("{:>8.2f}% {:>12}  {}\n", percent(count), count, symbol_name(symbol));
+    }
+
+    std::vector<std::pair<uint64_t, uint64_t>> pcs(pc_samples.begin(), pc_samples.end());
+    std::ranges::sort(pcs, std::greater{}, &std::pair<uint64_t, uint64_t>::second);
+    if (pcs.size() > HOT_PCS)
+        pcs.resize(HOT_PCS);
+
+    flat << std::format("\n# {:>7} {:>12}  {:<18}  {:<32}  {}\n", "self%", "samples", "pc", "location", "instruction");
+    for (const auto& [pc, count] : pcs) {
+        const ELF::Symbol* symbol = lookup(pc);
+        std::string location = symbol ? std::format("{}+0x{:x}", symbol->name, pc - symbol->addr) : "";
+        auto instr = fetch(pc);
+        flat << std::format("{:>8.2f}% {:>12}  0x{:016x}  {:<32}  {}\n", percent(count), count, pc, location,
+                            instr ? disassemble(pc, *instr) : "");
+    }
+
+    std::ofstream folded(path + ".folded");
+    if (!folded)
+        throw std::runtime_error("Can't open guest profile file: " + path + ".folded");
+    for (uint32_t id = 1; id < nodes.size(); id++) {
+        if (!node_samples[id])
+            continue;
+        std::vector<std::string> frames;
+        for (uint32_t node = id; node != 0; node = nodes[node].parent) {
+            frames.push_back(symbol_name(nodes[node].symbol));
+        }
+        std::string line;
+        for (auto it = frames.rbegin(); it != frames.rend(); ++it) {
+            line += (line.empty() ? "" : ";") + *it;
+        }
+        folded << line << " " << node_samples[id] << "\n";
+    }
+}
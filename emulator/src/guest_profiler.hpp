@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "disasm.hpp"
+#include "elf.hpp"
+
+/**
+ * @brief Sampling profiler of guest code fed by the fetch PC.
+ * Keeps a PC histogram and a shadow call stack inferred from symbol transitions:
+ * entering a function at its first instruction is a call, landing inside a function already on the stack is a return.
+ * Stacks are interned as a tree so a sample is a single counter increment.
+ */
+class GuestProfiler {
+public:
+    using SymbolLookup = std::function<const ELF::Symbol*(uint64_t)>;
+    using InstrLookup = std::function<std::optional<uint32_t>(uint64_t)>;
+
+    // fetch reads the guest instruction at a hot PC for the disassembly column
+    GuestProfiler(SymbolLookup lookup, InstrLookup fetch, uint64_t interval);
+
+    // The core fetched pc during the cycles [cycle, cycle + cycles)
+    void tick(uint64_t cycle, uint64_t pc, uint64_t cycles = 1);
+    // <path> gets the flat profile, <path>.folded the stacks in flamegraph.pl format
+    void write(const std::string& path) const;
+
+private:
+    static constexpr size_t MAX_DEPTH = 256;
+    static constexpr size_t HOT_PCS = 32;
+
+    struct StackNode {
+        uint32_t parent;
+        const ELF::Symbol* symbol;
+    };
+
+    SymbolLookup lookup;
+    InstrLookup fetch;
+    uint64_t interval;
+    uint64_t samples = 0;
+    std::unordered_map<uint64_t, uint64_t> pc_samples;
+
+    // Node 0 is the root, a stack is identified by its innermost node
+    std::vector<StackNode> nodes{{0, nullptr}};
+    std::vector<uint64_t> node_samples{0};
+    std::map<std::pair<uint32_t, const ELF::Symbol*>, uint32_t> children;
+    std::vector<uint32_t> stack;
+
+    uint64_t last_pc = UINT64_MAX;
+    const ELF::Symbol* current = nullptr;
+
+    void enter(uint64_t pc);
+    uint32_t child(uint32_t parent, const ELF::Symbol* symbol);
+    static std::string symbol_name(const ELF::Symbol* symbol);
+};
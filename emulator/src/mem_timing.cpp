@@ -0,0 +1,81 @@
+#include "mem_timing.hpp"
+
+#include <algorithm>
+#include <format>
+
+MemTimingModel::MemTimingModel(const memTimingConfig& config) : config(config) {
+    this->config.banks = std::max<uint64_t>(config.banks, 1);
+    reset();
+}
+
+uint64_t MemTimingModel::schedule(uint64_t now, uint64_t addr, uint64_t bytes) {
+    const uint64_t offset = addr - config.addr_low;
+    uint64_t start = now;
+    uint64_t access = config.latency;
+
+    if (config.row_bytes) {
+        // Rows are interleaved across banks
+        const uint64_t row_index = offset / config.row_bytes;
+        const uint64_t bank = row_index % config.banks;
+        const uint64_t row = row_index / config.banks;
+
+        start = std::max(start, bank_free[bank]);
+        const bool hit = open_rows[bank] == row;
+        const uint64_t row_cycles = hit ? config.row_hit : config.row_miss;
+        (hit ? stats.row_hits : stats.row_misses)++;
+        open_rows[bank] = row;
+        bank_free[bank] = start + row_cycles;
+        access += row_cycles;
+    }
+
+    uint64_t ready = start + access;
+    if (config.bytes_per_cycle) {
+        const uint64_t transfer = (bytes + config.bytes_per_cycle - 1) / config.bytes_per_cycle;
+        const uint64_t bus_start = std::max(ready, bus_free);
+        stats.queue_cycles += bus_start - ready;
+        ready = bus_start + transfer;
+        bus_free = ready;
+    }
+
+    stats.accesses++;
+    stats.queue_cycles += start - now;
+    stats.latency_cycles += ready - now;
+    return ready;
+}
+
+void MemTimingModel::reset() {
+    open_rows.assign(config.banks, ROW_CLOSED);
+    bank_free.assign(config.banks, 0);
+    bus_free = 0;
+    stats = {};
+}
+
+void MemTimingModel::save_state(VerilatedSerialize& os) {
+    save_vector(os, open_rows);
+    save_vector(os, bank_free);
+    save_pod(os, bus_free);
+    save_pod(os, stats);
+}
+
+void MemTimingModel::restore_state(VerilatedDeserialize& is) {
+    restore_vector(is, open_rows);
+    restore_vector(is, bank_free);
+    restore_pod(is, bus_free);
+    restore_pod(is, stats);
+}
+
+std::string MemTimingModel::report() const {
+    auto ratio = [](uint64_t part, uint64_t total) { return total ? static_cast<double>(part) / total : 0.0; };
+    std::string text = std::format("mem 0x{:x}-0x{:x}: {} accesses, avg latency {:.2f}, avg queue {:.2f} cycles",
+                                   config.addr_low, config.addr_high, stats.accesses,
+                                   ratio(stats.latency_cycles, stats.accesses), ratio(stats.queue_cycles, stats.accesses));
+    if (config.row_bytes)
+        text += std::format(", row hit {:.1f}%", 100 * ratio(stats.row_hits, stats.row_hits + stats.row_misses));
+    return text;
+}
+
+std::vector<memTimingConfig> default_mem_timing() {
+#define MEM_TIMING_REGION(...) memTimingConfig{__VA_ARGS__},
+    return { CFG_MEM_TIMING_REGIONS(MEM_TIMING_REGION) };
+#undef MEM_TIMING_REGION
+}
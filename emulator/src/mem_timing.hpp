@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "config.hpp"
+#include "checkpoint.hpp"
+
+struct memTimingConfig {
+    uint64_t addr_low;
+    uint64_t addr_high;
+    uint64_t latency;         // Fixed cycles added to every access
+    uint64_t banks;
+    uint64_t row_bytes;       // 0 disables the row-buffer model
+    uint64_t row_hit;
+    uint64_t row_miss;
+    uint64_t bytes_per_cycle; // 0 disables the bandwidth limit
+};
+
+/**
+ * @brief Timing of one memory region: fixed latency, open-row banks and a shared data bus.
+ * Accesses are scheduled when the bus accepts them and return the cycle their data is ready.
+ */
+class MemTimingModel {
+public:
+    struct Stats {
+        uint64_t accesses = 0;
+        uint64_t row_hits = 0;
+        uint64_t row_misses = 0;
+        uint64_t queue_cycles = 0;   // Waiting for a busy bank or the data bus
+        uint64_t latency_cycles = 0; // Acceptance to data ready
+    };
+
+    explicit MemTimingModel(const memTimingConfig& config);
+
+    bool contains(uint64_t addr) const { return addr >= config.addr_low && addr <= config.addr_high; }
+    uint64_t schedule(uint64_t now, uint64_t addr, uint64_t bytes);
+    void reset();
+    void save_state(VerilatedSerialize& os);
+    void restore_state(VerilatedDeserialize& is);
+
+    const memTimingConfig& get_config() const { return config; }
+    const Stats& get_stats() const { return stats; }
+    std::string report() const;
+
+private:
+    static constexpr uint64_t ROW_CLOSED = UINT64_MAX;
+
+    memTimingConfig config;
+    std::vector<uint64_t> open_rows;
+    std::vector<uint64_t> bank_free;
+    uint64_t bus_free = 0;
+    Stats stats;
+};
+
+// Regions listed under memoryTiming in core_config.yaml
+std::vector<memTimingConfig> default_mem_timing();
@@ -0,0 +1,58 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <format>
+#include <fstream>
+#include <stdexcept>
+
+size_t HostProfiler::add_counter(const std::string& group, const std::string& name) {
+    counters.push_back({group, name});
+    return counters.size() - 1;
+}
+
+void HostProfiler::begin() {
+    for (auto& counter : counters) {
+        counter.calls = 0;
+        counter.ticks = 0;
+    }
+    wall_begin = std::chrono::steady_clock::now();
+    ticks_begin = now();
+}
+
+void HostProfiler::end(uint64_t cycles) {
+    const uint64_t ticks = now() - ticks_begin;
+    wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_begin).count();
+    seconds_per_tick = ticks ? wall_seconds / ticks : 0;
+    this->cycles = cycles;
+}
+
+void HostProfiler::write_json(const std::string& path) const {
+    std::ofstream file(path);
+    if (!file)
+        throw std::runtime_error("Can't open stats file: " + path);
+
+    const double khz = wall_seconds > 0 ? cycles / wall_seconds / 1000 : 0;
+    file << std::format("{{\n  \"cycles\": {},\n  \"wall_time_s\": {:.6f},\n  \"sim_khz\": {:.3f}", cycles, wall_seconds, khz);
+
+    // Counters are emitted grouped, in registration order
+    std::vector<std::string> groups;
+    for (const auto& counter : counters) {
+        if (std::ranges::find(groups, counter.group) == groups.end())
+            groups.push_back(counter.group);
+    }
+    for (const auto& group : groups) {
+        file << std::format(",\n  \"{}\": {{", group);
+        bool first = true;
+        for (const auto& counter : counters) {
+            if (counter.group != group)
+                continue;
+            const double seconds = counter.ticks * seconds_per_tick;
+            file << std::format("{}\n    \"{}\": {{\"calls\": {}, \"time_s\": {:.6f}, \"share\": {:.4f}}}",
+                                first ? "" : ",", counter.name, counter.calls, seconds,
+                                wall_seconds > 0 ? seconds / wall_seconds : 0);
+            first = false;
+        }
+        file << "\n  }";
+    }
+    file << "\n}\n";
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/**
+ * @brief Host-side time accounting of the simulation loop.
+ * Counters are registered once and charged through RAII scopes, a null profiler costs a single branch.
+ * Times are taken from the TSC where available and calibrated against the steady clock over the run.
+ */
+class HostProfiler {
+public:
+    struct Counter {
+        std::string group;
+        std::string name;
+        uint64_t calls = 0;
+        uint64_t ticks = 0;
+    };
+
+    class Scope {
+    public:
+        Scope(HostProfiler* profiler, size_t id) : profiler(profiler), id(id) {
+            if (profiler)
+                start = now();
+        }
+        ~Scope() {
+            if (profiler)
+                profiler->charge(id, now() - start);
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    private:
+        HostProfiler* profiler;
+        size_t id;
+        uint64_t start = 0;
+    };
+
+    static uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    size_t add_counter(const std::string& group, const std::string& name);
+    void charge(size_t id, uint64_t ticks) {
+        counters[id].calls++;
+        counters[id].ticks += ticks;
+    }
+
+    void begin();
+    void end(uint64_t cycles);
+    void write_json(const std::string& path) const;
+
+private:
+    std::vector<Counter> counters;
+    std::chrono::steady_clock::time_point wall_begin;
+    uint64_t ticks_begin = 0;
+    double wall_seconds = 0;
+    double seconds_per_tick = 0;
+    uint64_t cycles = 0;
+};
@@ -48,4 +48,33 @@ void VirtualCLINT::step(const std::unique_ptr<VMarkoRvCore> &top) {
         top->io_msip = 1;
     else
         top->io_msip = 0;
-}
\ No newline at end of file
+}
+
+void VirtualCLINT::reset() {
+    mtime = 0;
+    mtimecmp = 0;
+    msip = 0;
+}
+
+void VirtualCLINT::save_state(VerilatedSerialize& os) {
+    save_pod(os, mtime);
+    save_pod(os, mtimecmp);
+    save_pod(os, msip);
+}
+
+void VirtualCLINT::restore_state(VerilatedDeserialize& is) {
+    restore_pod(is, mtime);
+    restore_pod(is, mtimecmp);
+    restore_pod(is, msip);
+}
+
+std::optional<uint64_t> VirtualCLINT::idle_cycles() {
+    // mtip is raised by the step that brings mtime to mtimecmp, no skipping once it is pending or about to be
+    if (mtime + 1 >= mtimecmp)
+        return 0;
+    return mtimecmp - mtime - 1;
+}
+
+void VirtualCLINT::skip_cycles(uint64_t cycles) {
+    mtime += cycles;
+}
@@ -15,7 +15,13 @@ public:
 
     uint64_t read(uint64_t addr, uint8_t size) override;
     void write(uint64_t addr, uint64_t data, uint8_t size, uint8_t strb) override;
+    const char* name() const override { return "clint"; }
     void step(const std::unique_ptr<VMarkoRvCore> &top) override;
+    void reset() override;
+    void save_state(VerilatedSerialize& os) override;
+    void restore_state(VerilatedDeserialize& is) override;
+    std::optional<uint64_t> idle_cycles() override;
+    void skip_cycles(uint64_t cycles) override;
 private:
     uint64_t mtime = 0;
     uint64_t mtimecmp = 0;
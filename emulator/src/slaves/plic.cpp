@@ -100,4 +100,33 @@ void VirtualPLIC::set_interrupt_level(uint16_t interrupt_id, bool level) {
     } else {
         source_asserted.erase(interrupt_id);
     }
+}
+
+void VirtualPLIC::reset() {
+    source_enable.fill(0);
+    source_priority.fill(0);
+    source_asserted.clear();
+    source_pending.clear();
+    source_processing.clear();
+    threshold = 0;
+}
+
+void VirtualPLIC::save_state(VerilatedSerialize& os) {
+    save_pod(os, source_enable);
+    save_pod(os, source_priority);
+    save_vector(os, std::vector<uint16_t>(source_asserted.begin(), source_asserted.end()));
+    save_vector(os, source_pending);
+    save_vector(os, source_processing);
+    save_pod(os, threshold);
+}
+
+void VirtualPLIC::restore_state(VerilatedDeserialize& is) {
+    std::vector<uint16_t> asserted;
+    restore_pod(is, source_enable);
+    restore_pod(is, source_priority);
+    restore_vector(is, asserted);
+    source_asserted = std::unordered_set<uint16_t>(asserted.begin(), asserted.end());
+    restore_vector(is, source_pending);
+    restore_vector(is, source_processing);
+    restore_pod(is, threshold);
 }
\ No newline at end of file
@@ -26,7 +26,11 @@ public:
 
     uint64_t read(uint64_t addr, uint8_t size) override;
     void write(uint64_t addr, uint64_t data, uint8_t size, uint8_t strb) override;
+    const char* name() const override { return "plic"; }
     void step(const std::unique_ptr<VMarkoRvCore> &top) override;
+    void reset() override;
+    void save_state(VerilatedSerialize& os) override;
+    void restore_state(VerilatedDeserialize& is) override;
 
     void set_interrupt_level(uint16_t interrupt_id, bool level) override;
 };
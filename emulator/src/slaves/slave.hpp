@@ -6,7 +6,9 @@
 #include <string>
 #include <vector>
 #include <functional>
+#include <optional>
 #include "VMarkoRvCore.h"
+#include "../checkpoint.hpp"
 
 #define CLINT_CONTROLER_TYPE 0
 #define PLIC_CONTROLER_TYPE 1
@@ -22,9 +24,22 @@ public:
         this->base_addr = base_addr;
     }
     virtual ~Slave() = default;
+    // Label used in reports
+    virtual const char* name() const { return "slave"; }
     virtual uint64_t read(uint64_t addr, uint8_t size) = 0;
     virtual void write(uint64_t addr, uint64_t data, uint8_t size, uint8_t strb) = 0;
     virtual void step(const std::unique_ptr<VMarkoRvCore> &top) {}
+    // Return to power-on state between jobs
+    virtual void reset() {}
+    // Checkpoint/restore of the device state
+    virtual void save_state(VerilatedSerialize& os) {}
+    virtual void restore_state(VerilatedDeserialize& is) {}
+    // Backing memory of a side-effect free slave for bulk burst access, nullptr if accesses must go through read/write
+    virtual uint8_t* direct_span(uint64_t addr, uint64_t bytes) { return nullptr; }
+    // Idle fast-forward, cycles that can pass before the device changes anything the core sees
+    // std::nullopt means it never does on its own
+    virtual std::optional<uint64_t> idle_cycles() { return std::nullopt; }
+    virtual void skip_cycles(uint64_t cycles) {}
 };
 
 class InterruptController : public Slave {
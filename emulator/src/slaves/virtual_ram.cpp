@@ -1,21 +1,41 @@
 #include "virtual_ram.hpp"
 
-VirtualRAM::VirtualRAM(uint64_t base_addr, const std::string& file_path, uint64_t size) : Slave(base_addr) {
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <fstream>
+
+VirtualRAM::VirtualRAM(uint64_t base_addr, uint64_t size, bool huge_pages, const std::optional<std::string>& backing_file)
+    : Slave(base_addr) {
     this->size = size;
-    assert((size & 0x0fff) == 0 && "Virtual RAM size must be 4k aligned.");
+    if (size == 0 || (size & 0x0fff) != 0)
+        throw std::runtime_error(std::format("Virtual RAM size({:x}) must be a non-zero multiple of 4k", size));
     range = std::ranges::iota_view<uint64_t, uint64_t>(0x0, size);
 
-    ram = static_cast<uint8_t*>(std::malloc(size));
-    if (!ram) throw std::runtime_error("Failed to allocate RAM");
-    std::memset(ram, 0, size);
-
-    if (init_ram(file_path, size)) {
-        throw std::runtime_error("Failed to initialize RAM");
+    void* mapping;
+    if (backing_file) {
+        // Start from an all-zero sparse file of the RAM size
+        backing_fd = open(backing_file->c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (backing_fd < 0 || ftruncate(backing_fd, size) != 0)
+            throw std::runtime_error("Can't create RAM backing file: " + *backing_file);
+        mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE, backing_fd, 0);
+    } else {
+        // Anonymous pages read as zero and are only committed on first write
+        mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
     }
+    if (mapping == MAP_FAILED)
+        throw std::runtime_error(std::format("Failed to map RAM of size {:x}", size));
+    ram = static_cast<uint8_t*>(mapping);
+#ifdef MADV_HUGEPAGE
+    if (huge_pages)
+        madvise(ram, size, MADV_HUGEPAGE);
+#endif
 }
 
 VirtualRAM::~VirtualRAM() {
-    if (ram) std::free(ram);
+    if (ram) munmap(ram, size);
+    if (backing_fd >= 0) close(backing_fd);
 }
 
 uint64_t VirtualRAM::read(uint64_t addr, uint8_t size) {
@@ -36,14 +56,35 @@ void VirtualRAM::write(uint64_t addr, uint64_t data, uint8_t size, uint8_t strb)
     }
 }
 
+uint8_t* VirtualRAM::direct_span(uint64_t addr, uint64_t bytes) {
+    if (addr >= size || bytes > size - addr)
+        return nullptr;
+    return ram + addr;
+}
+
+void VirtualRAM::reset() {
+    // Drop the touched pages instead of clearing them, they come back zero-filled
+    if (backing_fd >= 0) {
+        if (ftruncate(backing_fd, 0) == 0 && ftruncate(backing_fd, size) == 0)
+            return;
+    } else if (madvise(ram, size, MADV_DONTNEED) == 0) {
+        return;
+    }
+    std::memset(ram, 0, size);
+}
+
+void VirtualRAM::load(const std::string& file_path) {
+    if (init_ram(file_path, size)) {
+        throw std::runtime_error("Failed to initialize RAM");
+    }
+}
+
 int VirtualRAM::init_ram(const std::string& file_path, uint64_t size) {
-    std::ifstream file(file_path, std::ios::binary);
-    if (!file) {
+    if (!fs::exists(file_path)) {
         std::cerr << "Can't open file:" << file_path << std::endl;
         return 1;
     }
-    std::vector<uint8_t> raw((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-    auto elf = ELF::from_raw(raw);
+    auto elf = ELF::from_file(file_path);
 
     if (elf.get_class_type() != ELF::ClassType::ELFCLASS64)
         throw std::runtime_error("ELF class type must be ELFCLASS64");
@@ -58,8 +99,168 @@ int VirtualRAM::init_ram(const std::string& file_path, uint64_t size) {
         if (ph.p_filesz > this->size - target_addr)
             throw std::runtime_error(std::format("Write size({:x}) exceeds available memory space", ph.p_filesz));
 
-        std::memcpy(ram + target_addr, raw.data() + ph.p_offset, ph.p_filesz);
+        auto segment = elf.get_segment_data(ph);
+        std::memcpy(ram + target_addr, segment.data(), segment.size());
     }
 
     return 0;
 }
+
+
+void VirtualRAM::sync() {
+    if (backing_fd >= 0 && msync(ram, size, MS_SYNC) != 0)
+        throw std::runtime_error("Failed to sync the RAM backing file");
+}
+
+void VirtualRAM::dump(const std::string& path, const std::vector<std::pair<uint64_t, uint64_t>>& ranges, bool sparse) {
+    std::vector<std::pair<uint64_t, uint64_t>> offsets;
+    for (const auto& [addr, len] : ranges) {
+        if (addr < base_addr || addr - base_addr > size || len > size - (addr - base_addr))
+            throw std::runtime_error(std::format("Dump range {:x}+{:x} is outside RAM", addr, len));
+        offsets.emplace_back(addr - base_addr, len);
+    }
+    if (ranges.empty()) {
+        offsets.emplace_back(0, size);
+    }
+
+    std::ofstream file(path, std::ios::out | std::ios::binary);
+    if (!file)
+        throw std::runtime_error("Can't create dump file: " + path);
+    auto put = [&file](uint64_t value) { file.write(reinterpret_cast<const char*>(&value), sizeof(value)); };
+
+    if (!sparse) {
+        for (const auto& [offset, len] : offsets) {
+            file.write(reinterpret_cast<const char*>(ram + offset), len);
+        }
+        file.close();
+        if (!file)
+            throw std::runtime_error("Failed to write dump file: " + path);
+        return;
+    }
+
+    put(RAM_DUMP_SPARSE_MAGIC);
+    put(base_addr);
+    put(size);
+
+    for (const auto& [offset, len] : offsets) {
+        for_each_data_run(offset, len, [&](uint64_t run_start, uint64_t run_len) {
+            put(base_addr + run_start);
+            put(run_len);
+            file.write(reinterpret_cast<const char*>(ram + run_start), run_len);
+        });
+    }
+    file.close();
+    if (!file)
+        throw std::runtime_error("Failed to write dump file: " + path);
+}
+
+void VirtualRAM::for_each_data_run(uint64_t offset, uint64_t len, const std::function<void(uint64_t, uint64_t)>& fn) {
+    // Pages that never held data are skipped without faulting them in
+    const uint64_t page_size = sysconf(_SC_PAGESIZE);
+    const uint64_t first_page = offset / page_size;
+    const uint64_t last_page = (offset + len + page_size - 1) / page_size;
+    const auto candidates = data_pages(first_page, last_page - first_page, page_size);
+
+    uint64_t run_start = 0;
+    uint64_t run_len = 0;
+    for (uint64_t page = first_page; page < last_page; page++) {
+        const uint64_t begin = std::max(offset, page * page_size);
+        const uint64_t end = std::min(offset + len, (page + 1) * page_size);
+        const bool has_data = candidates[page - first_page] &&
+            std::any_of(ram + begin, ram + end, [](uint8_t byte) { return byte != 0; });
+        if (!has_data) {
+            if (run_len)
+                fn(run_start, run_len);
+            run_len = 0;
+            continue;
+        }
+        if (!run_len)
+            run_start = begin;
+        run_len = end - run_start;
+    }
+    if (run_len)
+        fn(run_start, run_len);
+}
+
+std::vector<bool> VirtualRAM::data_pages(uint64_t first_page, uint64_t pages, uint64_t page_size) {
+    // Without a usable source every page is scanned
+    std::vector<bool> candidates(pages, true);
+
+    if (backing_fd >= 0) {
+        // Written pages are allocated in the file once synced, holes read as zero
+        if (msync(ram, size, MS_SYNC) != 0)
+            return candidates;
+        std::vector<bool> allocated(pages, false);
+        const off_t end = (first_page + pages) * page_size;
+        off_t offset = first_page * page_size;
+        while (offset < end) {
+            const off_t data = lseek(backing_fd, offset, SEEK_DATA);
+            if (data < 0) {
+                if (errno == ENXIO)
+                    break;
+                return candidates;
+            }
+            off_t hole = lseek(backing_fd, data, SEEK_HOLE);
+            if (hole < 0)
+                return candidates;
+            hole = std::min(hole, end);
+            for (uint64_t page = data / page_size; page * page_size < static_cast<uint64_t>(hole); page++) {
+                if (page >= first_page)
+                    allocated[page - first_page] = true;
+            }
+            offset = hole;
+        }
+        return allocated;
+    }
+
+    // Anonymous pages that were ever written are present or swapped out, pagemap bits 63 and 62
+    int fd = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return candidates;
+    const uint64_t first_vpage = reinterpret_cast<uintptr_t>(ram) / page_size + first_page;
+    std::vector<uint64_t> entries(4096);
+    for (uint64_t done = 0; done < pages;) {
+        const uint64_t count = std::min<uint64_t>(entries.size(), pages - done);
+        const ssize_t bytes = pread(fd, entries.data(), count * sizeof(uint64_t), (first_vpage + done) * sizeof(uint64_t));
+        if (bytes != static_cast<ssize_t>(count * sizeof(uint64_t))) {
+            close(fd);
+            return std::vector<bool>(pages, true);
+        }
+        for (uint64_t i = 0; i < count; i++) {
+            candidates[done + i] = entries[i] & (3ULL << 62);
+        }
+        done += count;
+    }
+    close(fd);
+    return candidates;
+}
+
+// Only runs of pages holding data are saved as {offset, len, bytes[len]}, an offset of size ends the list
+void VirtualRAM::save_state(VerilatedSerialize& os) {
+    save_pod(os, size);
+    for_each_data_run(0, size, [&](uint64_t offset, uint64_t len) {
+        save_pod(os, offset);
+        save_pod(os, len);
+        os.write(ram + offset, len);
+    });
+    save_pod(os, size);
+}
+
+void VirtualRAM::restore_state(VerilatedDeserialize& is) {
+    uint64_t saved_size = 0;
+    restore_pod(is, saved_size);
+    if (saved_size != size)
+        throw std::runtime_error(std::format("Checkpoint RAM size({:x}) does not match({:x})", saved_size, size));
+    reset();
+    for (;;) {
+        uint64_t offset = 0;
+        uint64_t len = 0;
+        restore_pod(is, offset);
+        if (offset == size)
+            break;
+        restore_pod(is, len);
+        if (offset > size || len > size - offset)
+            throw std::runtime_error(std::format("Checkpoint RAM run {:x}+{:x} is outside RAM", offset, len));
+        is.read(ram + offset, len);
+    }
+}
\ No newline at end of file
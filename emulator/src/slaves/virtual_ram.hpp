@@ -3,21 +3,49 @@
 #include <cstdint>
 #include <memory>
 #include <cassert>
+#include <functional>
+#include <optional>
+#include <utility>
+#include <vector>
 
 #include "slave.hpp"
 #include "../elf.hpp"
 
+// Sparse dump: header {magic, base, size}, then records {addr, len, bytes[len]}, all u64 little-endian.
+// Only pages holding non-zero data are written, everything else reads back as zero.
+#define RAM_DUMP_SPARSE_MAGIC 0x3150534d44564d52ULL // "RMVDMSP1"
+
 class VirtualRAM : public Slave {
 public:
-    explicit VirtualRAM(uint64_t base_addr, const std::string& file_path, uint64_t size);
+    // Backed by a lazily committed anonymous mapping, only touched pages cost memory.
+    // With a backing file the mapping is shared with it, so the file always holds the memory image.
+    explicit VirtualRAM(uint64_t base_addr, uint64_t size, bool huge_pages = false,
+                        const std::optional<std::string>& backing_file = std::nullopt);
     ~VirtualRAM();
 
     uint64_t read(uint64_t addr, uint8_t size) override;
     void write(uint64_t addr, uint64_t data, uint8_t size, uint8_t strb) override;
+    const char* name() const override { return "ram"; }
+    uint8_t* direct_span(uint64_t addr, uint64_t bytes) override;
+    void reset() override;
+    void save_state(VerilatedSerialize& os) override;
+    void restore_state(VerilatedDeserialize& is) override;
+    void load(const std::string& file_path);
+    // Write the whole memory or the given (bus addr, len) ranges, raw or sparse
+    void dump(const std::string& path, const std::vector<std::pair<uint64_t, uint64_t>>& ranges, bool sparse);
+    // Flush a file-backed memory to its file
+    void sync();
+    bool file_backed() const { return backing_fd >= 0; }
 
     uint8_t* ram;
     uint64_t size;
 
 private:
+    int backing_fd = -1;
+
     int init_ram(const std::string& file_path, uint64_t size);
+    // Calls fn(offset, len) for the runs of [offset, offset + len) on pages holding non-zero data
+    void for_each_data_run(uint64_t offset, uint64_t len, const std::function<void(uint64_t, uint64_t)>& fn);
+    // Pages of [first_page, first_page + pages) that may hold data, the others read as zero
+    std::vector<bool> data_pages(uint64_t first_page, uint64_t pages, uint64_t page_size);
 };
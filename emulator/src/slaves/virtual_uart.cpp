@@ -1,8 +1,40 @@
 #include "virtual_uart.hpp"
 
-VirtualUart::VirtualUart(uint64_t base_addr, uint16_t irq_id) : Slave(base_addr), irq_id(irq_id) {
+#include <cerrno>
+#include <poll.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <cstring>
+
+VirtualUart::VirtualUart(uint64_t base_addr, uint16_t irq_id, bool interactive)
+    : Slave(base_addr), irq_id(irq_id), interactive(interactive) {
     range = std::ranges::iota_view<uint64_t, uint64_t>(0x0, 0x100);
-    enable_raw_mode();
+    reset();
+    if (interactive) {
+        enable_raw_mode();
+        if (pipe(stdin_wake) != 0)
+            throw std::runtime_error("Can't create the UART stdin wake pipe.");
+        stdin_thread = std::thread(&VirtualUart::stdin_reader, this);
+    }
+}
+
+VirtualUart::~VirtualUart() {
+    close_output();
+    if (interactive) {
+        stdin_stop = true;
+        [[maybe_unused]] auto written = ::write(stdin_wake[1], "", 1);
+        stdin_thread.join();
+        close(stdin_wake[0]);
+        close(stdin_wake[1]);
+        disable_raw_mode();
+    }
+}
+
+void VirtualUart::reset() {
+    close_output();
+    rx_buffer = {};
     rbr_reg = 0;
     thr_reg = 0;
     ier_reg = 0;
@@ -15,10 +47,6 @@ VirtualUart::VirtualUart(uint64_t base_addr, uint16_t irq_id) : Slave(base_addr)
     spr_reg = 0;
 }
 
-VirtualUart::~VirtualUart() {
-    disable_raw_mode();
-}
-
 void VirtualUart::enable_raw_mode() {
     tcgetattr(STDIN_FILENO, &orig_termios);
 
@@ -39,17 +67,32 @@ void VirtualUart::disable_raw_mode() {
     tcsetattr(STDIN_FILENO, TCSAFLUSH, &orig_termios);
 }
 
-bool VirtualUart::read_byte_from_stdin(uint8_t &ch) {
-    fd_set set;
-    struct timeval timeout = {0, 0};
-    FD_ZERO(&set);
-    FD_SET(STDIN_FILENO, &set);
-    if (select(STDIN_FILENO + 1, &set, NULL, NULL, &timeout) > 0) {
-        if (::read(STDIN_FILENO, &ch, 1) == 1) {
-            return true;
+void VirtualUart::stdin_reader() {
+    struct pollfd fds[2] = {{STDIN_FILENO, POLLIN, 0}, {stdin_wake[0], POLLIN, 0}};
+    while (!stdin_stop) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        if (fds[1].revents)
+            return;
+        if (!fds[0].revents)
+            continue;
+
+        uint8_t chunk[256];
+        ssize_t count = ::read(STDIN_FILENO, chunk, sizeof(chunk));
+        if (count <= 0)
+            return; // EOF or error, nothing more to deliver
+        for (ssize_t i = 0; i < count; i++) {
+            // The ring only fills up when the guest stops draining, wait for it
+            while (!stdin_ring.push(chunk[i])) {
+                if (stdin_stop)
+                    return;
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
         }
     }
-    return false;
 }
 
 uint64_t VirtualUart::read(uint64_t addr, uint8_t size) {
@@ -89,7 +132,9 @@ void VirtualUart::write(uint64_t addr, uint64_t data, uint8_t size, uint8_t strb
     switch (addr) {
         case 0x0: // THR
             thr_reg = val;
-            std::cout << static_cast<char>(val) << std::flush;
+            tx_buffer.push_back(static_cast<char>(val));
+            if (val == '\n' || tx_buffer.size() >= CFG_UART_TX_BUFFER_SIZE)
+                flush_tx();
             break;
         case 0x1: // IER
             ier_reg = val;
@@ -111,11 +156,128 @@ void VirtualUart::write(uint64_t addr, uint64_t data, uint8_t size, uint8_t strb
     }
 }
 
+void VirtualUart::set_output(const std::string& spec) {
+    close_output();
+
+    int fd = -1;
+    if (spec == "pty") {
+        fd = posix_openpt(O_RDWR | O_NOCTTY);
+        if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0)
+            throw std::runtime_error("Can't allocate a pty for the UART.");
+        // Nobody may be attached, drop output rather than stall the simulation
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        std::cerr << "UART output on " << ptsname(fd) << std::endl;
+    } else if (spec.starts_with("unix:")) {
+        const std::string path = spec.substr(5);
+        struct sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path))
+            throw std::runtime_error("UART socket path too long: " + path);
+        std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+            if (fd >= 0)
+                close(fd);
+            throw std::runtime_error("Can't connect the UART to socket: " + path);
+        }
+    } else {
+        fd = open(spec.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+            throw std::runtime_error("Can't open UART output file: " + spec);
+    }
+    tx_fd = fd;
+    tx_fd_owned = true;
+    tx_is_socket = spec.starts_with("unix:");
+}
+
+void VirtualUart::close_output() {
+    flush_tx();
+    if (tx_fd_owned)
+        close(tx_fd);
+    tx_fd = interactive ? STDOUT_FILENO : STDERR_FILENO;
+    tx_fd_owned = false;
+    tx_is_socket = false;
+}
+
+void VirtualUart::flush_tx() {
+    tx_pending_cycles = 0;
+    if (tx_buffer.empty())
+        return;
+    // Keep ordering with whatever the harness printed through iostreams
+    if (tx_fd == STDOUT_FILENO)
+        std::cout.flush();
+    else if (tx_fd == STDERR_FILENO)
+        std::cerr.flush();
+
+    size_t offset = 0;
+    while (offset < tx_buffer.size()) {
+        // A closed socket peer must not raise SIGPIPE
+        ssize_t written = tx_is_socket
+            ? send(tx_fd, tx_buffer.data() + offset, tx_buffer.size() - offset, MSG_NOSIGNAL)
+            : ::write(tx_fd, tx_buffer.data() + offset, tx_buffer.size() - offset);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            break; // Sink gone or full, the rest is dropped
+        offset += written;
+    }
+    tx_buffer.clear();
+}
+
+void VirtualUart::push_input(const std::vector<uint8_t> &data) {
+    if (data.empty())
+        return;
+    for (const auto ch : data) {
+        rx_buffer.push(ch);
+    }
+    lsr_reg |= LSR_DATA_READY;
+    trigger_interrupt_level(irq_id, true);
+}
+
 void VirtualUart::step(const std::unique_ptr<VMarkoRvCore> &top) {
+    if (!tx_buffer.empty() && ++tx_pending_cycles >= CFG_UART_TX_FLUSH_INTERVAL)
+        flush_tx();
+
     uint8_t ch;
-    if (read_byte_from_stdin(ch)) {
+    if (interactive && stdin_ring.pop(ch)) {
         rx_buffer.push(ch);
         lsr_reg |= LSR_DATA_READY;
         trigger_interrupt_level(irq_id, true);
     }
 }
+
+std::optional<uint64_t> VirtualUart::idle_cycles() {
+    // Keyboard input can arrive any time, keep polling the stdin ring
+    if (interactive)
+        return CFG_IDLE_SKIP_POLL_INTERVAL;
+    return std::nullopt;
+}
+
+void VirtualUart::skip_cycles(uint64_t cycles) {
+    flush_tx();
+}
+
+void VirtualUart::save_state(VerilatedSerialize& os) {
+    // Output so far belongs before the checkpoint, a restored run doesn't print it again
+    flush_tx();
+    std::vector<uint8_t> rx_pending;
+    for (auto queue = rx_buffer; !queue.empty(); queue.pop()) {
+        rx_pending.push_back(queue.front());
+    }
+    save_vector(os, rx_pending);
+    for (const auto reg : {rbr_reg, thr_reg, ier_reg, isr_reg, fcr_reg, lcr_reg, mcr_reg, lsr_reg, msr_reg, spr_reg}) {
+        save_pod(os, reg);
+    }
+}
+
+void VirtualUart::restore_state(VerilatedDeserialize& is) {
+    std::vector<uint8_t> rx_pending;
+    restore_vector(is, rx_pending);
+    rx_buffer = {};
+    for (const auto ch : rx_pending) {
+        rx_buffer.push(ch);
+    }
+    for (auto reg : {&rbr_reg, &thr_reg, &ier_reg, &isr_reg, &fcr_reg, &lcr_reg, &mcr_reg, &lsr_reg, &msr_reg, &spr_reg}) {
+        restore_pod(is, *reg);
+    }
+}
\ No newline at end of file
@@ -1,31 +1,62 @@
 #pragma once
 #include <queue>
+#include <vector>
 #include <memory>
+#include <thread>
+#include <atomic>
 #include <cstdint>
+#include <string>
 #include <iostream>
 #include <termios.h>
 #include <unistd.h>
 
 #include "VMarkoRvCore.h"
+#include "../config.hpp"
+#include "../spsc_ring.hpp"
 #include "slave.hpp"
 
 class VirtualUart : public Slave, public InterruptSource {
 public:
-    VirtualUart(uint64_t base_addr, uint16_t irq_id);
+    // A non-interactive UART leaves stdin alone and transmits to stderr by default
+    VirtualUart(uint64_t base_addr, uint16_t irq_id, bool interactive = true);
     ~VirtualUart();
 
     uint64_t read(uint64_t addr, uint8_t size) override;
     void write(uint64_t addr, uint64_t data, uint8_t size, uint8_t strb) override;
+    const char* name() const override { return "uart"; }
     void step(const std::unique_ptr<VMarkoRvCore> &top) override;
+    void reset() override;
+    void push_input(const std::vector<uint8_t> &data);
+    // Send TX to a file path, "pty" or "unix:<socket path>" until the next reset
+    void set_output(const std::string& spec);
+    void flush_tx();
+    void skip_cycles(uint64_t cycles) override;
+    void save_state(VerilatedSerialize& os) override;
+    void restore_state(VerilatedDeserialize& is) override;
+    std::optional<uint64_t> idle_cycles() override;
 
 private:
     void enable_raw_mode();
     void disable_raw_mode();
-    bool read_byte_from_stdin(uint8_t &ch);
+    void stdin_reader();
+    void close_output();
 
     std::queue<uint8_t> rx_buffer;
+    // Keyboard input is read on a background thread, step() only polls the ring
+    SpscRing<uint8_t, CFG_UART_RX_RING_SIZE> stdin_ring;
+    std::thread stdin_thread;
+    std::atomic<bool> stdin_stop = false;
+    int stdin_wake[2] = {-1, -1};
+
+    // TX bytes are batched and flushed on newline, size or after CFG_UART_TX_FLUSH_INTERVAL cycles
+    std::string tx_buffer;
+    uint64_t tx_pending_cycles = 0;
+    int tx_fd = STDOUT_FILENO;
+    bool tx_fd_owned = false;
+    bool tx_is_socket = false;
     struct termios orig_termios;
     uint16_t irq_id;
+    bool interactive;
 
     // 16550 register set
     uint8_t rbr_reg; // Receiver Buffer Register (read only)
@@ -0,0 +1,95 @@
+#pragma once
+#include <cstdint>
+
+// On-disk layout of simulator trace files, host endian (little on every supported host).
+// A stream trace (--exec-trace) holds every simulated cycle, the delta records of a cycle precede its cycle record.
+// A flight trace holds the cycle records of the last cycles before a failure.
+constexpr uint64_t TRACE_MAGIC = 0x31304543415254ULL; // "TRACE01"
+constexpr uint32_t TRACE_VERSION = 2;  // 2: retire flags from update_retire, TRACE_INTERRUPT
+
+enum trace_kind_t : uint32_t { TRACE_KIND_STREAM = 0, TRACE_KIND_FLIGHT = 1 };
+
+// Why a flight recorder dump was written
+enum flight_reason_t : uint32_t { FLIGHT_TIMEOUT, FLIGHT_DECERR, FLIGHT_TRAP_VECTOR, FLIGHT_SIGNAL, FLIGHT_REASON_NUM };
+constexpr const char* flight_reason_names[FLIGHT_REASON_NUM] = {"timeout", "decerr", "trap-vector", "signal"};
+
+struct traceHeader {
+    uint64_t magic = TRACE_MAGIC;
+    uint32_t version = TRACE_VERSION;
+    uint32_t record_size;
+    uint32_t kind;           // trace_kind_t
+    uint32_t reason;         // flight_reason_t of a flight dump
+    uint64_t trigger_cycle;  // Cycle the flight dump was triggered at
+    uint64_t records;        // Records following the header, oldest first
+};
+
+// Every record is record_size bytes and starts with the cycle and the record type
+enum trace_record_t : uint8_t {
+    TRACE_RECORD_CYCLE = 0,  // traceRecord
+    TRACE_RECORD_ROB   = 1,  // traceDelta of a changed ROB entry
+    TRACE_RECORD_RS    = 2,  // traceDelta of a changed reservation station entry
+    TRACE_RECORD_RT    = 3,  // traceDelta of a changed rename table mapping
+    TRACE_RECORD_RF    = 4,  // traceDelta of a changed physical register
+    TRACE_RECORD_NUM
+};
+constexpr const char* trace_record_names[TRACE_RECORD_NUM] = {"cycle", "rob", "rs", "rt", "rf"};
+
+// traceRecord::flags
+enum trace_flag_t : uint16_t {
+    TRACE_FETCH     = 1 << 0,  // instr holds the fetched instruction
+    TRACE_RETIRE    = 1 << 1,  // retire_pc retired from the ROB head
+    TRACE_TRAP      = 1 << 2,  // The retired instruction trapped with cause
+    TRACE_REDIRECT  = 1 << 3,  // The retired instruction redirected fetch (mispredict, fence.i)
+    TRACE_XRET      = 1 << 4,  // The retired instruction returned from a trap
+    TRACE_WFI       = 1 << 5,  // The core waits in wfi
+    TRACE_RESET     = 1 << 6,
+    TRACE_INTERRUPT = 1 << 7  // An interrupt with cause was taken, the ROB was empty
+};
+
+// traceRecord::axi, handshakes completed in the cycle
+enum trace_axi_t : uint16_t {
+    TRACE_AXI_AR    = 1 << 0,  // ar_addr
+    TRACE_AXI_R     = 1 << 1,
+    TRACE_AXI_RLAST = 1 << 2,
+    TRACE_AXI_AW    = 1 << 3,  // aw_addr
+    TRACE_AXI_W     = 1 << 4,
+    TRACE_AXI_B     = 1 << 5,
+    TRACE_AXI_RERR  = 1 << 6,  // R beat with SLVERR or DECERR
+    TRACE_AXI_BERR  = 1 << 7   // B response with SLVERR or DECERR
+};
+
+// One simulated cycle
+struct traceRecord {
+    uint64_t cycle;
+    uint8_t type;        // trace_record_t
+    uint8_t reserved0;
+    uint16_t flags;      // trace_flag_t
+    uint16_t axi;        // trace_axi_t
+    int16_t cause;
+    uint32_t instr;
+    uint32_t reserved1;
+    uint64_t fetch_pc;
+    uint64_t retire_pc;
+    uint64_t ar_addr;
+    uint64_t aw_addr;
+};
+static_assert(sizeof(traceRecord) == 56, "traceRecord is an on-disk format");
+
+// New state of one DPI structure entry, invalid ROB/RS entries are all zero but the index.
+//   ROB: index = entry, data = {pc, recover_pc, bits, xepc, xtval}
+//        bits: 0 valid, 1 commited, 2 trap, 3 recover, 4 xret, 5 prd_valid, 8-10 exu, 12-14 discon_type,
+//              16-31 cause, 32-47 prd, 48-63 prev_prd
+//   RS:  index = entry, data = {pc, pred_pc, bits, source1, source2}
+//        bits: 0 valid, 1 pred_taken, 2 prs1_valid, 3 prs2_valid, 4-6 exu, 8-23 rob_index,
+//              24-39 op key (InstrMixStats), 40-51 prs1, 52-63 prs2
+//   RT:  index = checkpoint << 5 | arch reg, data = {phys reg}
+//   RF:  index = phys reg, data = {value, state}
+struct traceDelta {
+    uint64_t cycle;
+    uint8_t type;        // trace_record_t
+    uint8_t reserved0;
+    uint16_t index;
+    uint32_t reserved1;
+    uint64_t data[5];
+};
+static_assert(sizeof(traceDelta) == sizeof(traceRecord), "Trace records share one size");
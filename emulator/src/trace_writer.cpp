@@ -0,0 +1,102 @@
+#include "trace_writer.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+TraceWriter::TraceWriter(const std::string& path, bool use_mmap) : path(path), use_mmap(use_mmap) {
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw std::runtime_error("Can't open trace file: " + path);
+
+    // Placeholder header, the record count is only known on close
+    traceHeader header;
+    header.record_size = sizeof(traceRecord);
+    header.kind = TRACE_KIND_STREAM;
+    header.reason = 0;
+    header.trigger_cycle = 0;
+    header.records = 0;
+    if (use_mmap) {
+        next_window();
+    } else {
+        buffer.resize(CFG_TRACE_BUFFER_SIZE);
+        window = buffer.data();
+        window_size = buffer.size();
+    }
+    write_split(&header, sizeof(header));
+}
+
+TraceWriter::~TraceWriter() {
+    try {
+        close();
+    } catch (...) {
+    }
+}
+
+void TraceWriter::write_split(const void* data, uint64_t size) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    while (size) {
+        if (fill == window_size)
+            next_window();
+        const uint64_t count = std::min(size, window_size - fill);
+        std::memcpy(window + fill, bytes, count);
+        fill += count;
+        bytes += count;
+        size -= count;
+    }
+}
+
+void TraceWriter::next_window() {
+    if (!use_mmap) {
+        release_window();
+        return;
+    }
+    if (window) {
+        release_window();
+        window_offset += window_size;
+    }
+    // The chunk is a multiple of the page size, so every window stays page aligned
+    window_size = CFG_TRACE_MMAP_CHUNK;
+    if (ftruncate(fd, window_offset + window_size) != 0)
+        throw std::runtime_error("Can't grow trace file: " + path);
+    void* mapping = mmap(nullptr, window_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, window_offset);
+    if (mapping == MAP_FAILED)
+        throw std::runtime_error("Can't map trace file: " + path);
+    window = static_cast<uint8_t*>(mapping);
+    fill = 0;
+}
+
+// Hand the filled part of the window to the file
+void TraceWriter::release_window() {
+    if (use_mmap) {
+        if (window)
+            munmap(window, window_size);
+        window = nullptr;
+        return;
+    }
+    for (uint64_t written = 0; written < fill;) {
+        ssize_t count = write(fd, window + written, fill - written);
+        if (count < 0)
+            throw std::runtime_error("Can't write trace file: " + path);
+        written += count;
+    }
+    fill = 0;
+}
+
+void TraceWriter::close() {
+    if (fd < 0)
+        return;
+    const uint64_t size = window_offset + fill;
+    release_window();
+    if (use_mmap && ftruncate(fd, size) != 0)
+        throw std::runtime_error("Can't truncate trace file: " + path);
+
+    if (pwrite(fd, &records, sizeof(records), offsetof(traceHeader, records)) != sizeof(records))
+        throw std::runtime_error("Can't write trace file: " + path);
+    ::close(fd);
+    fd = -1;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "config.hpp"
+#include "trace_format.hpp"
+
+/**
+ * @brief Append-only writer of a stream trace.
+ * Records are copied into a CFG_TRACE_BUFFER_SIZE buffer that is written out when full, or with mmap
+ * straight into CFG_TRACE_MMAP_CHUNK windows of the file. The header is patched with the record count on close.
+ */
+class TraceWriter {
+public:
+    TraceWriter(const std::string& path, bool use_mmap);
+    ~TraceWriter();
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    template <typename T>
+    void append(const T& record) {
+        static_assert(sizeof(T) == sizeof(traceRecord), "Trace records share one size");
+        if (fill + sizeof(T) <= window_size) {
+            std::memcpy(window + fill, &record, sizeof(T));
+            fill += sizeof(T);
+        } else {
+            write_split(&record, sizeof(T));
+        }
+        records++;
+    }
+    void close();
+
+private:
+    std::string path;
+    int fd = -1;
+    bool use_mmap;
+    std::vector<uint8_t> buffer;
+    uint8_t* window = nullptr;  // buffer, or the mapped chunk at window_offset
+    uint64_t window_size = 0;
+    uint64_t window_offset = 0;
+    uint64_t fill = 0;
+    uint64_t records = 0;
+
+    // Copy across the end of the window
+    void write_split(const void* data, uint64_t size);
+    void next_window();
+    void release_window();
+};
@@ -0,0 +1,50 @@
+#include "waveform.hpp"
+
+#include <stdexcept>
+
+WaveformTracer::WaveformTracer(const waveformConfig& config, VerilatedContext* context, VMarkoRvCore* top)
+    : file(std::make_unique<WaveformFile>()), trigger_length(config.trigger_length) {
+    if (config.triggered) {
+        start = UINT64_MAX;
+    } else {
+        start = config.window_start.value_or(0);
+        end = config.window_end.value_or(UINT64_MAX);
+    }
+
+    // Scopes must be set before the model registers its signals
+    if (!config.scopes.empty()) {
+        file->dumpvars(1, "TOP");
+        for (const auto& scope : config.scopes) {
+            file->dumpvars(99, scope.starts_with("TOP.") ? scope : "TOP.MarkoRvCore." + scope);
+        }
+    }
+    context->traceEverOn(true);
+    top->trace(file.get(), 99);
+    file->open(config.path.c_str());
+    if (!file->isOpen())
+        throw std::runtime_error("Can't open waveform file: " + config.path);
+}
+
+WaveformTracer::~WaveformTracer() {
+    close();
+}
+
+void WaveformTracer::trigger(uint64_t cycle) {
+    if (active(cycle))
+        return;
+    start = cycle;
+    end = trigger_length ? cycle + *trigger_length : UINT64_MAX;
+}
+
+std::optional<uint64_t> WaveformTracer::next_edge(uint64_t cycle) const {
+    if (cycle < start && start != UINT64_MAX)
+        return start;
+    if (cycle < end && end != UINT64_MAX)
+        return end;
+    return std::nullopt;
+}
+
+void WaveformTracer::close() {
+    if (file && file->isOpen())
+        file->close();
+}
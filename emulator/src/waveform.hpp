@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#ifdef MARKORV_TRACE_FST
+#include <verilated_fst_c.h>
+using WaveformFile = VerilatedFstC;
+constexpr bool WAVEFORM_FST = true;
+#else
+#include <verilated_vcd_c.h>
+using WaveformFile = VerilatedVcdC;
+constexpr bool WAVEFORM_FST = false;
+#endif
+
+#include "VMarkoRvCore.h"
+
+struct waveformConfig {
+    std::string path;
+    std::vector<std::string> scopes;         // Instances under the core (rob, dCache) or full TOP.* paths
+    std::optional<uint64_t> window_start;    // Cycle range traced without a trigger
+    std::optional<uint64_t> window_end;      // Exclusive
+    bool triggered = false;                  // Tracing waits for trigger()
+    std::optional<uint64_t> trigger_length;  // Cycles traced per trigger, to the end of the run if unset
+};
+
+/**
+ * @brief Waveform dump of the model limited to a cycle window and a set of scopes.
+ * The trace file is attached for the whole run, dumps outside the window are skipped,
+ * so the cost outside the window is Verilator's change tracking only.
+ * The format (VCD or FST) is fixed when the model is verilated, see TRACE_FST in the Makefile.
+ */
+class WaveformTracer {
+public:
+    WaveformTracer(const waveformConfig& config, VerilatedContext* context, VMarkoRvCore* top);
+    ~WaveformTracer();
+    WaveformTracer(const WaveformTracer&) = delete;
+    WaveformTracer& operator=(const WaveformTracer&) = delete;
+
+    // Open a window at cycle unless one is already open
+    void trigger(uint64_t cycle);
+    bool active(uint64_t cycle) const { return cycle >= start && cycle < end; }
+    void dump(uint64_t cycle, uint64_t time) {
+        if (active(cycle))
+            file->dump(time);
+    }
+    // First cycle after now the window opens or closes, bounds idle skipping
+    std::optional<uint64_t> next_edge(uint64_t cycle) const;
+    void close();
+
+private:
+    std::unique_ptr<WaveformFile> file;
+    std::optional<uint64_t> trigger_length;
+    uint64_t start = 0;
+    uint64_t end = UINT64_MAX;
+};
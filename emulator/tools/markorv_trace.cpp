@@ -0,0 +1,306 @@
+// markorv-trace: offline decoder of the binary traces written by --exec-trace and the flight recorder
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cxxopts.hpp>
+
+#include "disasm.hpp"
+#include "elf.hpp"
+#include "trace_format.hpp"
+
+static constexpr const char* exu_names[] = {"ALU", "BRU", "LSU", "MDU", "MISC", "?", "?", "?"};
+static constexpr const char* rf_state_names[] = {"FREE", "ALLOCATED", "OCCUPIED", "COMMITTED"};
+
+struct traceFilter {
+    uint64_t cycle_start = 0;
+    uint64_t cycle_end = UINT64_MAX;
+    std::optional<std::pair<uint64_t, uint64_t>> pc_range;
+    std::vector<bool> types = std::vector<bool>(TRACE_RECORD_NUM, true);
+    bool retired_only = false;
+    bool axi_only = false;
+};
+
+class TraceDecoder {
+public:
+    TraceDecoder(std::vector<ELF> elves, bool disasm) : elves(std::move(elves)), disasm(disasm) {}
+
+    std::string symbolize(uint64_t addr) const {
+        for (const auto& elf : elves) {
+            auto symbol = elf.symbolize(addr);
+            if (!symbol.empty())
+                return " <" + symbol + ">";
+        }
+        return "";
+    }
+
+    std::string cycle(const traceRecord& record) {
+        std::string line = std::format("0x{:08x} ", record.cycle);
+        if (record.flags & TRACE_RESET)
+            line += "reset ";
+        if (record.flags & TRACE_FETCH) {
+            line += std::format("F 0x{:016x}{} {:08x}", record.fetch_pc, symbolize(record.fetch_pc), record.instr);
+            if (disasm)
+                line += " " + disasm_cache.get(record.fetch_pc, record.instr);
+        } else {
+            line += std::format("- 0x{:016x}", record.fetch_pc);
+        }
+        if (record.flags & TRACE_WFI)
+            line += " wfi";
+        if (record.flags & TRACE_RETIRE) {
+            line += std::format(" | retire 0x{:016x}{}", record.retire_pc, symbolize(record.retire_pc));
+            if (record.flags & TRACE_TRAP)
+                line += std::format(" trap cause={}", record.cause);
+            if (record.flags & TRACE_REDIRECT)
+                line += " redirect";
+            if (record.flags & TRACE_XRET)
+                line += " xret";
+        }
+        if (record.flags & TRACE_INTERRUPT)
+            line += std::format(" | interrupt cause={}", record.cause);
+        if (record.axi) {
+            line += " | axi";
+            if (record.axi & TRACE_AXI_AR)
+                line += std::format(" AR 0x{:x}", record.ar_addr);
+            if (record.axi & TRACE_AXI_R)
+                line += (record.axi & TRACE_AXI_RLAST) ? " R(last)" : " R";
+            if (record.axi & TRACE_AXI_RERR)
+                line += " RERR";
+            if (record.axi & TRACE_AXI_AW)
+                line += std::format(" AW 0x{:x}", record.aw_addr);
+            if (record.axi & TRACE_AXI_W)
+                line += " W";
+            if (record.axi & TRACE_AXI_B)
+                line += " B";
+            if (record.axi & TRACE_AXI_BERR)
+                line += " BERR";
+        }
+        return line;
+    }
+
+    std::string delta(const traceDelta& delta) const {
+        std::string line = std::format("0x{:08x} ", delta.cycle);
+        const uint64_t bits = delta.data[2];
+        switch (delta.type) {
+            case TRACE_RECORD_ROB:
+                if (!(bits & 1))
+                    return line + std::format("rob[{}] invalid", delta.index);
+                line += std::format("rob[{}] pc=0x{:016x}{} exu={} prd={}{} prev_prd={}", delta.index, delta.data[0],
+                                    symbolize(delta.data[0]), exu_names[bits >> 8 & 7], bits >> 32 & 0xffff,
+                                    (bits >> 5 & 1) ? "" : "(none)", bits >> 48);
+                if (bits >> 1 & 1)
+                    line += " commited";
+                if (bits >> 2 & 1)
+                    line += std::format(" trap cause={} tval=0x{:x}", static_cast<int16_t>(bits >> 16), delta.data[4]);
+                if (bits >> 3 & 1)
+                    line += std::format(" recover=0x{:x}", delta.data[1]);
+                if (bits >> 4 & 1)
+                    line += std::format(" xret epc=0x{:x}", delta.data[3]);
+                return line;
+            case TRACE_RECORD_RS:
+                if (!(bits & 1))
+                    return line + std::format("rs[{}] invalid", delta.index);
+                line += std::format("rs[{}] pc=0x{:016x}{} exu={} op=0x{:04x} rob={}", delta.index, delta.data[0],
+                                    symbolize(delta.data[0]), exu_names[bits >> 4 & 7], bits >> 24 & 0xffff, bits >> 8 & 0xffff);
+                if (bits >> 2 & 1)
+                    line += std::format(" prs1={}", bits >> 40 & 0xfff);
+                else
+                    line += std::format(" src1=0x{:x}", delta.data[3]);
+                if (bits >> 3 & 1)
+                    line += std::format(" prs2={}", bits >> 52 & 0xfff);
+                else
+                    line += std::format(" src2=0x{:x}", delta.data[4]);
+                if (bits >> 1 & 1)
+                    line += std::format(" pred=0x{:x}", delta.data[1]);
+                return line;
+            case TRACE_RECORD_RT:
+                return line + std::format("rt[{}] x{} -> p{}", delta.index >> 5, delta.index & 31, delta.data[0]);
+            case TRACE_RECORD_RF:
+                return line + std::format("rf[p{}] 0x{:016x} {}", delta.index, delta.data[0], rf_state_names[delta.data[1] & 3]);
+            default:
+                return line + std::format("unknown record type {}", delta.type);
+        }
+    }
+
+private:
+    std::vector<ELF> elves;
+    bool disasm;
+    DisasmCache disasm_cache;
+};
+
+static bool in_pc_range(const traceFilter& filter, uint64_t pc) {
+    return pc >= filter.pc_range->first && pc < filter.pc_range->second;
+}
+
+static bool keep(const traceFilter& filter, const uint8_t* data) {
+    traceRecord record;
+    std::memcpy(&record, data, sizeof(record));
+    if (record.cycle < filter.cycle_start || record.cycle >= filter.cycle_end)
+        return false;
+    if (record.type >= TRACE_RECORD_NUM || !filter.types[record.type])
+        return false;
+    if (record.type != TRACE_RECORD_CYCLE) {
+        if (filter.retired_only || filter.axi_only)
+            return false;
+        traceDelta delta;
+        std::memcpy(&delta, data, sizeof(delta));
+        if (filter.pc_range && (delta.type == TRACE_RECORD_ROB || delta.type == TRACE_RECORD_RS))
+            return in_pc_range(filter, delta.data[0]);
+        return !filter.pc_range;
+    }
+    if (filter.retired_only && !(record.flags & TRACE_RETIRE))
+        return false;
+    if (filter.axi_only && !record.axi)
+        return false;
+    if (filter.pc_range) {
+        return in_pc_range(filter, record.fetch_pc) || ((record.flags & TRACE_RETIRE) && in_pc_range(filter, record.retire_pc));
+    }
+    return true;
+}
+
+static std::pair<uint64_t, uint64_t> parse_range(const std::string& option, const std::string& value) {
+    auto sep = value.find(':');
+    if (sep == std::string::npos)
+        throw std::runtime_error(std::format("--{} takes hex start:end", option));
+    uint64_t start = sep ? std::stoull(value.substr(0, sep), nullptr, 16) : 0;
+    uint64_t end = sep + 1 < value.size() ? std::stoull(value.substr(sep + 1), nullptr, 16) : UINT64_MAX;
+    return {start, end};
+}
+
+int main(int argc, char** argv) {
+    cxxopts::Options options(argv[0], "Decoder of MarkoRvCore simulator traces");
+    options.add_options()
+        ("trace", "Trace file written by --exec-trace or the flight recorder", cxxopts::value<std::string>())
+        ("elf", "ELF files to symbolize PCs with (comma separated)", cxxopts::value<std::vector<std::string>>())
+        ("cycles", "Only records of these cycles (hex start:end, both optional, end exclusive)", cxxopts::value<std::string>())
+        ("pc", "Only records of PCs in this range (hex start:end, end exclusive)", cxxopts::value<std::string>())
+        ("types", "Record types to print (comma separated: cycle,rob,rs,rt,rf)", cxxopts::value<std::vector<std::string>>())
+        ("retired", "Only cycles that retired an instruction")
+        ("axi", "Only cycles with AXI handshakes")
+        ("no-disasm", "Print raw instructions only")
+        ("summary", "Print record counts instead of the records")
+        ("help", "Print usage information");
+    options.parse_positional({"trace"});
+    options.positional_help("<trace>");
+
+    try {
+        auto result = options.parse(argc, argv);
+        if (result.count("help") || !result.count("trace")) {
+            std::cout << options.help() << std::endl;
+            return result.count("help") ? 0 : 1;
+        }
+
+        traceFilter filter;
+        if (result.count("cycles")) {
+            std::tie(filter.cycle_start, filter.cycle_end) = parse_range("cycles", result["cycles"].as<std::string>());
+        }
+        if (result.count("pc")) {
+            filter.pc_range = parse_range("pc", result["pc"].as<std::string>());
+        }
+        if (result.count("types")) {
+            filter.types.assign(TRACE_RECORD_NUM, false);
+            for (const auto& type : result["types"].as<std::vector<std::string>>()) {
+                auto it = std::ranges::find(trace_record_names, type);
+                if (it == std::end(trace_record_names))
+                    throw std::runtime_error("Unknown record type: " + type);
+                filter.types[it - std::begin(trace_record_names)] = true;
+            }
+        }
+        filter.retired_only = result.count("retired") > 0;
+        filter.axi_only = result.count("axi") > 0;
+
+        std::vector<ELF> elves;
+        if (result.count("elf")) {
+            for (const auto& path : result["elf"].as<std::vector<std::string>>()) {
+                elves.push_back(ELF::from_file(path));
+            }
+        }
+
+        const auto path = result["trace"].as<std::string>();
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("Can't open trace file: " + path);
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(traceHeader)) {
+            close(fd);
+            throw std::runtime_error("Not a trace file: " + path);
+        }
+        const size_t size = st.st_size;
+        void* base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED)
+            throw std::runtime_error("Can't map trace file: " + path);
+        madvise(base, size, MADV_SEQUENTIAL);
+        const auto* data = static_cast<const uint8_t*>(base);
+
+        traceHeader header;
+        std::memcpy(&header, data, sizeof(header));
+        if (header.magic != TRACE_MAGIC || header.version != TRACE_VERSION || header.record_size != sizeof(traceRecord))
+            throw std::runtime_error("Not a compatible trace file: " + path);
+        // An interrupted writer leaves the count at zero, trust the file size then
+        uint64_t records = (size - sizeof(header)) / header.record_size;
+        if (header.records)
+            records = std::min(records, header.records);
+
+        if (header.kind == TRACE_KIND_FLIGHT) {
+            std::cout << std::format("flight recorder: {} at 0x{:x}, {} cycles\n",
+                                     header.reason < FLIGHT_REASON_NUM ? flight_reason_names[header.reason] : "unknown",
+                                     header.trigger_cycle, records);
+        }
+
+        TraceDecoder decoder(std::move(elves), !result.count("no-disasm") && !result.count("summary"));
+        std::vector<uint64_t> counts(TRACE_RECORD_NUM);
+        uint64_t retired = 0;
+        uint64_t traps = 0;
+        std::string out;
+        for (uint64_t i = 0; i < records; i++) {
+            const uint8_t* raw = data + sizeof(header) + i * header.record_size;
+            if (!keep(filter, raw))
+                continue;
+            traceRecord record;
+            std::memcpy(&record, raw, sizeof(record));
+            if (result.count("summary")) {
+                counts[record.type]++;
+                retired += record.type == TRACE_RECORD_CYCLE && (record.flags & TRACE_RETIRE);
+                traps += record.type == TRACE_RECORD_CYCLE && (record.flags & (TRACE_TRAP | TRACE_INTERRUPT));
+                continue;
+            }
+            if (record.type == TRACE_RECORD_CYCLE) {
+                out += decoder.cycle(record);
+            } else {
+                traceDelta delta;
+                std::memcpy(&delta, raw, sizeof(delta));
+                out += decoder.delta(delta);
+            }
+            out += '\n';
+            if (out.size() >= 1 << 16) {
+                std::fwrite(out.data(), 1, out.size(), stdout);
+                out.clear();
+            }
+        }
+        std::fwrite(out.data(), 1, out.size(), stdout);
+        munmap(base, size);
+
+        if (result.count("summary")) {
+            for (size_t type = 0; type < TRACE_RECORD_NUM; type++) {
+                std::cout << std::format("{:<6} {}\n", trace_record_names[type], counts[type]);
+            }
+            std::cout << std::format("{:<6} {}\n", "retire", retired);
+            std::cout << std::format("{:<6} {}\n", "trap", traps);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
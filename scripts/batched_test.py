@@ -1,17 +1,20 @@
-import os
+import json
 import pathlib
 import argparse
+import threading
 import subprocess
 from concurrent.futures import ThreadPoolExecutor, as_completed
 
 from rich import print
-from elftools.elf.elffile import ELFFile
 
 BASE_PATH = pathlib.Path(__file__).parent.parent
 TESTS_PATH = BASE_PATH / "tests" / "riscv-tests" / "isa"
 EMULATOR_PATH = BASE_PATH / "obj_dir" / "VMarkoRvCore"
 ROM_PATH = BASE_PATH / "emulator" / "assets" / "boot.elf"
-RAM_DUMP_PATH = BASE_PATH / "tests" / "ram_dump.bin"
+
+# Exit codes reported by the emulator when the payload has a .tohost section
+EXIT_PASS = 0
+EXIT_TOHOST_FAIL = 2
 
 TEST_CASES = [
 # I Extension
@@ -114,43 +117,46 @@ jobs = args.jobs
 passed_count = 0
 failed_count = 0
 
+# One persistent emulator per worker thread, fed through --server mode
+servers = threading.local()
+server_processes = []
+server_lock = threading.Lock()
+
+def get_server():
+    if not hasattr(servers, "process"):
+        servers.process = subprocess.Popen(
+            [str(EMULATOR_PATH), "--server"],
+            stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.DEVNULL, text=True
+        )
+        with server_lock:
+            server_processes.append(servers.process)
+    return servers.process
+
 def run_test(case_name):
-    tohost_offset = None
-    tohost_addr = None
-    with open(TESTS_PATH / case_name, 'rb') as file:
-        elf = ELFFile(file)
-        for section in elf.iter_sections():
-            if section.name == ".tohost":
-                tohost_addr = section['sh_addr']
-                tohost_offset = tohost_addr - 0x80000000
-                break
-
-    ram_dump_path = BASE_PATH / "tests" / f"{case_name}.ram_dump.bin"
-    command = [
-        str(EMULATOR_PATH),
+    server = get_server()
+    job = [
         "--rom-path", str(ROM_PATH),
         "--ram-path", str(TESTS_PATH / case_name),
         "--max-clock", "10000",
-        "--ram-dump", str(ram_dump_path),
-        "--cleanup-dcache", str(tohost_addr)
     ]
-    result = subprocess.run(command, capture_output=True, text=True, stdin=subprocess.DEVNULL)
-    if result.returncode != 0:
-        return (False, case_name, None)
+    server.stdin.write(" ".join(job) + "\n")
+    server.stdin.flush()
 
-    if tohost_offset is None:
+    # Anything that is not a JSON result (e.g. option parser help) is skipped
+    for line in server.stdout:
+        if line.startswith("{"):
+            result = json.loads(line)
+            break
+    else:
         return (False, case_name, None)
 
-    with open(ram_dump_path, "rb") as file:
-        file.seek(tohost_offset)
-        result_value = int.from_bytes(file.read(2), byteorder="little")
+    if result["exit"] == EXIT_PASS:
+        return (True, case_name, None)
 
-    os.remove(ram_dump_path)
+    if result["exit"] == EXIT_TOHOST_FAIL:
+        return (False, case_name, result["tohost"] >> 1)
 
-    if result_value == 1:
-        return (True, case_name, None)
-    else:
-        return (False, case_name, result_value >> 1)
+    return (False, case_name, None)
 
 with ThreadPoolExecutor(max_workers=jobs) as executor:
     future_to_case = {executor.submit(run_test, case): case for case in TEST_CASES}
@@ -167,6 +173,10 @@ with ThreadPoolExecutor(max_workers=jobs) as executor:
                 print(f"[ERROR] while testing {case_name}")
             failed_count += 1
 
+for process in server_processes:
+    process.stdin.close()
+    process.wait()
+
 total_cases = len(TEST_CASES)
 pass_rate = (passed_count / total_cases) * 100 if total_cases > 0 else 0
 